@@ -47,10 +47,10 @@ echo ""
 cp $GOLDENDIR/traces/* .
 
 MAX=2
-MAXTOTAL=10
+MAXTOTAL=18
 
 TOTAL=0
-for algo in rand opt fifo lru clock; do
+for algo in rand opt fifo lru clock arc 2q lirs clockpro; do
 	MARK=0
 	for trace in 1_trace 4_trace; do
 		./sim -f $trace -m 8 -s 12 -a $algo | tail --lines=7 > $trace.out
@@ -73,6 +73,24 @@ echo ""
 
 echo "Total Mark: $TOTAL/$MAXTOTAL"
 
+# With --scope local, FIFO must evict each process's oldest page
+./sim -f local_trace -m 4 -s 100 -a fifo --scope local | tail --lines=7 > local_trace.out
+diff -b local_trace.out $GOLDENDIR/fifo/local_trace.golden.out > /dev/null
+if [ $? -eq 0 ]; then
+	echo "Local FIFO: passed"
+else
+	echo "Local FIFO: failed"
+fi
+
+# Huge pages must not be promoted over and over on a trace larger than memory
+./sim -f huge_trace -m 1024 -s 4096 -P radix --huge 64 -a lru | grep "^Huge" > huge_trace.out
+diff -b huge_trace.out $GOLDENDIR/huge/huge_trace.golden.out > /dev/null
+if [ $? -eq 0 ]; then
+	echo "Huge pages: passed"
+else
+	echo "Huge pages: failed"
+fi
+
 rm -rf *trace*
 
 cd $CURDIR
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include "pagetable.h"
+#include "sim.h"
+#include "ilist.h"
+
+/* ARC, Adaptive Replacement Cache (Megiddo and Modha, FAST 2003).
+ *
+ * Resident pages are split between T1 (seen once recently) and T2 (seen at
+ * least twice). Ghost lists B1 and B2 remember pages recently evicted from
+ * T1 and T2. A fault on a page in B1 means T1 was too small, so the target
+ * size of T1 grows, and a fault on a page in B2 shrinks it. A single scan
+ * of new pages can then only push out T1, never the frequently used pages
+ * in T2. T1 and T2 are lists of frames; B1 and B2 share a pool of memsize
+ * ghost slots, which is all the history ARC ever needs.
+ */
+
+#define T1 0
+#define T2 1
+#define B1 0
+#define B2 1
+
+static struct ilist *res;     // T1 and T2, over frame numbers
+static struct ghost *hist;    // B1 and B2
+static int target;            // Target size of T1 ("p" in the paper)
+
+// A faulting page found in a ghost list by arc_evict, and which one, so
+// that arc_ref knows to put it straight into T2
+static pgtbl_entry_t *arrival;
+static int arrival_list;
+
+static int max(int a, int b) {
+	return a > b ? a : b;
+}
+
+static int min(int a, int b) {
+	return a < b ? a : b;
+}
+
+/* Forgets the oldest page on ghost list b. */
+static void drop_ghost(int b) {
+	int slot = ilist_tail(hist->l, b);
+	if (slot != -1) {
+		ghost_remove(hist, slot);
+	}
+}
+
+/* Evicts the LRU page of T1 or T2 into the matching ghost list, following
+ * ARC's REPLACE rule. in_b2 says whether the faulting page was in B2.
+ */
+static int replace(int in_b2) {
+	int t1 = res->size[T1];
+	int list, frame;
+
+	if (t1 >= 1 && ((in_b2 && t1 == target) || t1 > target)) {
+		list = T1;
+	} else {
+		list = T2;
+	}
+	if (res->size[list] == 0) {
+		list = 1 - list;
+	}
+	frame = ilist_tail(res, list);
+	ilist_remove(res, frame);
+	if (hist->nfree == 0) {
+		drop_ghost(hist->l->size[B1] > 0 ? B1 : B2);
+	}
+	ghost_add(hist, list == T1 ? B1 : B2, coremap[frame].pte);
+	return frame;
+}
+
+/* Page to evict is chosen using the ARC algorithm.
+ * Returns the page frame number (which is also the index in the coremap)
+ * for the page that is to be evicted.
+ */
+int arc_evict() {
+	int c = memsize;
+	int slot = ghost_find(hist, fault_pte);
+	int b1 = hist->l->size[B1], b2 = hist->l->size[B2];
+	int t1 = res->size[T1];
+	int frame;
+
+	arrival = fault_pte;
+	arrival_list = -1;
+	if (slot != -1) {
+		// Cases II and III: a ghost hit adapts the target size of T1
+		arrival_list = hist->l->which[slot];
+		if (arrival_list == B1) {
+			target = min(c, target + max(b2 / b1, 1));
+		} else {
+			target = max(0, target - max(b1 / b2, 1));
+		}
+		ghost_remove(hist, slot);
+		return replace(arrival_list == B2);
+	}
+
+	// Case IV: a page ARC has no record of
+	if (t1 + b1 == c) {
+		if (t1 < c) {
+			drop_ghost(B1);
+		} else {
+			// B1 is empty; the LRU page of T1 leaves no ghost
+			frame = ilist_tail(res, T1);
+			ilist_remove(res, frame);
+			return frame;
+		}
+	} else if (c + b1 + b2 >= 2 * c) {
+		drop_ghost(B2);
+	}
+	return replace(0);
+}
+
+/* This function is called on each access to a page to update any information
+ * needed by the ARC algorithm.
+ * Input: The page table entry for the page that is being accessed.
+ */
+void arc_ref(pgtbl_entry_t *p) {
+	int frame = p->frame >> PAGE_SHIFT;
+	int slot;
+
+	if (res->which[frame] != -1) {
+		// Case I: a hit moves the page to the MRU end of T2
+		ilist_remove(res, frame);
+		ilist_push(res, T2, frame);
+		return;
+	}
+
+	if (p == arrival && arrival_list != -1) {
+		ilist_push(res, T2, frame);
+	} else if ((slot = ghost_find(hist, p)) != -1) {
+		// Remembered, but memory was not full so nothing was evicted
+		ghost_remove(hist, slot);
+		ilist_push(res, T2, frame);
+	} else {
+		ilist_push(res, T1, frame);
+	}
+	arrival = NULL;
+}
+
+/* Initialize any data structures needed for this
+ * replacement algorithm
+ */
+void arc_init() {
+	res = ilist_create(memsize, 2);
+	hist = ghost_create(memsize, 2);
+	target = 0;
+	arrival = NULL;
+}
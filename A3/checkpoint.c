@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "sim.h"
+#include "checkpoint.h"
+
+/* Checkpointing saves everything the simulation depends on every N
+ * references, so that a run over a very long trace can be carried on with
+ * --resume after it is interrupted, and gives the same results as if it
+ * had not been.
+ *
+ * The state is written by a forked child, which gets a copy-on-write
+ * snapshot of the simulator's memory for free, so replay only stops for
+ * the fork and for copying the swapfile (which the child shares with it).
+ * The file is written under a temporary name and renamed into place, so
+ * the previous checkpoint stays good until the new one is complete. Only
+ * one writer runs at a time: if the next checkpoint is due before it has
+ * finished, replay waits for it.
+ */
+
+unsigned long checkpoint_every = 0;
+char *checkpoint_file = NULL;
+
+static uint64_t replayed;             // References replayed, including
+                                      // those before a resume
+static pid_t writer = -1;             // Child writing a checkpoint, or -1
+static uint64_t writer_refs;          // The reference it was taken at
+static int in_writer = 0;             // Set in the child
+static unsigned long written, failed;
+static uint64_t last_written;
+
+static char *resumed_from = NULL;
+static uint64_t resumed_at;
+static FILE *resume_fp;
+static struct checkpoint_header resume_hdr;
+
+/* Exits after an error, without flushing the parent's stdio buffers
+ * again if this is the writer.
+ */
+static void ckpt_fail() {
+	if (in_writer) {
+		_exit(1);
+	}
+	exit(1);
+}
+
+/* Writes len bytes to a checkpoint, exiting if that fails. */
+void ckpt_write(FILE *fp, const void *buf, size_t len) {
+	if (len > 0 && fwrite(buf, len, 1, fp) != 1) {
+		perror("Error writing checkpoint");
+		ckpt_fail();
+	}
+}
+
+/* Reads len bytes from a checkpoint, exiting if there are not that many. */
+void ckpt_read(FILE *fp, void *buf, size_t len) {
+	if (len > 0 && fread(buf, len, 1, fp) != 1) {
+		fprintf(stderr, "Error: checkpoint is truncated or unreadable\n");
+		ckpt_fail();
+	}
+}
+
+static void write_string(FILE *fp, const char *s) {
+	uint32_t len = strlen(s);
+
+	ckpt_write(fp, &len, sizeof(len));
+	ckpt_write(fp, s, len);
+}
+
+static char *read_string(FILE *fp) {
+	uint32_t len;
+	char *s;
+
+	ckpt_read(fp, &len, sizeof(len));
+	if (len > 4096 || (s = malloc(len + 1)) == NULL) {
+		fprintf(stderr, "Error: bad string in checkpoint\n");
+		exit(1);
+	}
+	ckpt_read(fp, s, len);
+	s[len] = '\0';
+	return s;
+}
+
+/* Returns the size of the trace file, to tell later if it has changed. */
+static uint64_t trace_size() {
+	struct stat st;
+
+	if (stat(tracefile, &st) == -1) {
+		perror("Error reading tracefile");
+		exit(1);
+	}
+	return st.st_size;
+}
+
+/* Writes the checkpoint, in the child. Returns 0 on success, -1 on error. */
+static int write_checkpoint(struct trace_pos *pos, char *snap) {
+	struct checkpoint_header hdr;
+	char *tmp = malloc(strlen(checkpoint_file) + 5);
+	FILE *fp;
+
+	sprintf(tmp, "%s.tmp", checkpoint_file);
+	if ((fp = fopen(tmp, "wb")) == NULL) {
+		perror("Error opening checkpoint file");
+		return -1;
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CKPT_MAGIC, CKPT_MAGIC_LEN);
+	hdr.version = CKPT_VERSION;
+	hdr.memsize = memsize;
+	hdr.swapsize = swap_slots_total();
+	hdr.radix = pagetable_radix;
+	hdr.replace_local = replace_local;
+	hdr.refs = replayed;
+	hdr.trace_size = trace_size();
+	hdr.pos = *pos;
+	ckpt_write(fp, &hdr, sizeof(hdr));
+	write_string(fp, algorithm_name);
+	write_string(fp, tracefile);
+	write_string(fp, swap_backend);
+
+	pagetable_save(fp);
+	swap_save(fp, snap);
+	save_fcn(fp);
+	ckpt_write(fp, CKPT_MAGIC, CKPT_MAGIC_LEN);
+
+	if (fflush(fp) != 0 || fsync(fileno(fp)) != 0 || fclose(fp) != 0) {
+		perror("Error writing checkpoint");
+		return -1;
+	}
+	if (rename(tmp, checkpoint_file) != 0) {
+		perror("Error renaming checkpoint");
+		return -1;
+	}
+	return 0;
+}
+
+/* Waits for the checkpoint being written, if any, and notes how it went. */
+static void wait_writer() {
+	int status;
+
+	if (writer == -1) {
+		return;
+	}
+	while (waitpid(writer, &status, 0) == -1 && errno == EINTR) {
+	}
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+		written++;
+		last_written = writer_refs;
+	} else {
+		fprintf(stderr, "Warning: checkpoint at reference %lu failed\n",
+			(unsigned long)writer_refs);
+		failed++;
+	}
+	writer = -1;
+}
+
+/* Takes a checkpoint of the simulation after the reference just replayed
+ * from tr.
+ */
+static void take_checkpoint(struct trace *tr) {
+	struct trace_pos pos;
+	char *snap;
+
+	wait_writer();
+	if (trace_tell(tr, &pos) != 0) {
+		perror("Error finding position in tracefile");
+		exit(1);
+	}
+	// The child must not see the parent move on through the swapfile
+	snap = swap_snapshot();
+	writer_refs = replayed;
+	writer = fork();
+	if (writer == 0) {
+		in_writer = 1;
+		_exit(write_checkpoint(&pos, snap) == 0 ? 0 : 1);
+	}
+	if (writer == -1) {
+		// No child to hand it to, so write it here
+		perror("checkpoint: fork");
+		if (write_checkpoint(&pos, snap) == 0) {
+			written++;
+			last_written = replayed;
+		} else {
+			failed++;
+		}
+	}
+	free(snap);
+}
+
+/* Called after each reference is replayed. */
+void checkpoint_ref(struct trace *tr) {
+	if (++replayed % checkpoint_every == 0) {
+		take_checkpoint(tr);
+	}
+}
+
+/* Waits for the last checkpoint to be written, at the end of the replay. */
+void checkpoint_finish() {
+	wait_writer();
+}
+
+void checkpoint_report() {
+	if (resumed_from != NULL) {
+		printf("Resumed from %s at reference %lu\n", resumed_from,
+		       (unsigned long)resumed_at);
+	}
+	if (checkpoint_every) {
+		printf("Checkpoints: %lu written to %s", written, checkpoint_file);
+		if (written > 0) {
+			printf(", the last at reference %lu",
+			       (unsigned long)last_written);
+		}
+		if (failed > 0) {
+			printf(", %lu failed", failed);
+		}
+		printf("\n");
+	}
+}
+
+/* Opens a checkpoint to carry on from and sets up the configuration it
+ * was taken with: memsize, the page table layout, the replacement scope,
+ * the swap backend, and the trace (unless one was given with -f). Sets
+ * *swapsize and returns the name of the algorithm. The state itself is
+ * read by resume_restore, once the simulation has been set up.
+ */
+char *resume_open(char *path, unsigned *swapsize) {
+	char *alg, *trace, *backend;
+
+	if ((resume_fp = fopen(path, "rb")) == NULL) {
+		perror("Error opening checkpoint");
+		exit(1);
+	}
+	ckpt_read(resume_fp, &resume_hdr, sizeof(resume_hdr));
+	if (memcmp(resume_hdr.magic, CKPT_MAGIC, CKPT_MAGIC_LEN) != 0 ||
+	    resume_hdr.version != CKPT_VERSION) {
+		fprintf(stderr, "Error: %s is not a checkpoint of this version\n",
+			path);
+		exit(1);
+	}
+	alg = read_string(resume_fp);
+	trace = read_string(resume_fp);
+	backend = read_string(resume_fp);
+	if (tracefile == NULL) {
+		tracefile = trace;
+	}
+	if (trace_size() != resume_hdr.trace_size) {
+		fprintf(stderr, "Error: %s is not the trace the checkpoint was "
+			"taken from\n", tracefile);
+		exit(1);
+	}
+	memsize = resume_hdr.memsize;
+	*swapsize = resume_hdr.swapsize;
+	pagetable_radix = resume_hdr.radix;
+	replace_local = resume_hdr.replace_local;
+	if (swap_select(backend) != 0) {
+		fprintf(stderr, "Error: invalid swap backend - %s\n", backend);
+		exit(1);
+	}
+	swap_backend = backend;
+	resumed_from = path;
+	return alg;
+}
+
+/* Restores the state saved in the checkpoint opened by resume_open, after
+ * init_simulation and the algorithm's init, and moves tr to where the
+ * checkpoint was taken.
+ */
+void resume_restore(struct trace *tr) {
+	char magic[CKPT_MAGIC_LEN];
+
+	pagetable_load(resume_fp);
+	swap_load(resume_fp);
+	load_fcn(resume_fp);
+	ckpt_read(resume_fp, magic, CKPT_MAGIC_LEN);
+	if (memcmp(magic, CKPT_MAGIC, CKPT_MAGIC_LEN) != 0) {
+		fprintf(stderr, "Error: checkpoint %s is corrupt\n", resumed_from);
+		exit(1);
+	}
+	fclose(resume_fp);
+	if (trace_seek(tr, &resume_hdr.pos) != 0) {
+		fprintf(stderr, "Error: checkpoint position is not in %s\n",
+			tracefile);
+		exit(1);
+	}
+	replayed = resumed_at = resume_hdr.refs;
+}
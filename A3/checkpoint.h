@@ -0,0 +1,46 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include "trace.h"
+
+/* Checkpoints of a simulation in progress (--checkpoint-every), which a
+ * later run can carry on from (--resume).
+ *
+ * A checkpoint file starts with a checkpoint_header and the names of the
+ * algorithm, the trace and the swap backend, followed by the state saved
+ * by pagetable_save, swap_save and the algorithm's save function in turn,
+ * and ends with the magic again so that a truncated file is noticed. It is only meant to be
+ * read back by the same build of sim on the same machine.
+ */
+#define CKPT_MAGIC     "\177SIMCKP"
+#define CKPT_MAGIC_LEN 8
+#define CKPT_VERSION   2
+
+struct checkpoint_header {
+	char magic[CKPT_MAGIC_LEN];
+	uint32_t version;
+	uint32_t memsize;
+	uint32_t swapsize;
+	int32_t radix;            // pagetable_radix
+	int32_t replace_local;
+	int32_t pad;
+	uint64_t refs;            // References replayed
+	uint64_t trace_size;      // Size of the trace file, to check it is the same
+	struct trace_pos pos;     // Where to carry on in the trace
+};
+
+extern unsigned long checkpoint_every;   // 0 if not checkpointing
+extern char *checkpoint_file;
+
+// For the save and load functions of each part of the simulation. Both
+// exit on error.
+extern void ckpt_write(FILE *fp, const void *buf, size_t len);
+extern void ckpt_read(FILE *fp, void *buf, size_t len);
+
+extern void checkpoint_ref(struct trace *tr);
+extern void checkpoint_finish(void);
+extern void checkpoint_report(void);
+extern char *resume_open(char *path, unsigned *swapsize);
+extern void resume_restore(struct trace *tr);
+
+#endif /* __CHECKPOINT_H__ */
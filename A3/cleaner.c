@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "pagetable.h"
+#include "sim.h"
+#include "cleaner.h"
+
+/* A background page cleaner, enabled with --cleaner LOW[,HIGH[,US]].
+ *
+ * Without it, a fault whose victim is dirty writes the victim out before
+ * the new page can come in, and the fault takes that much longer. The
+ * cleaner models a daemon like kswapd that writes dirty pages out ahead
+ * of time, so that the victim is more often clean. It wakes up when fewer
+ * than LOW frames are free or clean, and writes pages out until HIGH
+ * (default 2 * LOW) are. It runs between references, as if it had the
+ * disk to itself while the process was computing.
+ *
+ * The cleaner has a clock hand of its own, the front hand of a two-handed
+ * clock. It passes over frames whose page has been referenced since it
+ * last came by (PG_REF, which it clears), as they are likely to be
+ * written again soon, and writes out the dirty pages in frames that have
+ * not. A page it has written carries PG_CLEANED until it is either
+ * evicted, which is then a clean eviction that would have been a dirty
+ * one, or written to again, which makes the write-back wasted.
+ *
+ * The latency saved is modelled as one page write of US microseconds
+ * (default 100) per fault that found its victim already cleaned.
+ */
+
+int cleaner_low = 0;                  // LOW, or 0 if the cleaner is off
+static int cleaner_high;
+static unsigned long write_us = 100;
+
+unsigned long cleaner_saved = 0;      // Evictions made clean by it
+unsigned long cleaner_redirtied = 0;  // Pages written again after it
+
+static int hand = 0;
+static unsigned long wakeups = 0;
+static unsigned long cleaned = 0;
+static unsigned long scanned = 0;
+
+/* Parses "LOW[,HIGH[,US]]". Returns 0 on success, -1 if spec is invalid. */
+int cleaner_configure(char *spec) {
+	char *end;
+
+	cleaner_low = (int)strtol(spec, &end, 10);
+	cleaner_high = 2 * cleaner_low;
+	if (*end == ',') {
+		cleaner_high = (int)strtol(end + 1, &end, 10);
+		if (*end == ',') {
+			write_us = strtoul(end + 1, &end, 10);
+		}
+	}
+	if (*end != '\0' || cleaner_low < 1 || cleaner_high < cleaner_low) {
+		return -1;
+	}
+	return 0;
+}
+
+/* Writes out dirty pages until HIGH frames are free or clean, or the hand
+ * has been twice round memory (the first time clearing PG_REF).
+ */
+void cleaner_run() {
+	int steps, frame;
+	pgtbl_entry_t *p;
+	int high = cleaner_high < (int)memsize ? cleaner_high : (int)memsize;
+
+	wakeups++;
+	for (steps = 0; steps < 2 * (int)memsize &&
+	     (int)memsize - dirty_frames < high; steps++) {
+		frame = hand;
+		hand = (hand + 1) % memsize;
+		p = coremap[frame].pte;
+		if (!coremap[frame].in_use || !(p->frame & PG_DIRTY)) {
+			continue;
+		}
+		if (p->frame & PG_REF) {
+			p->frame &= ~PG_REF;
+			continue;
+		}
+		if (writeback_page(p) != 0) {
+			break;    // Out of swap; eviction will report it
+		}
+		cleaned++;
+	}
+	scanned += steps;
+}
+
+void cleaner_report() {
+	printf("Cleaner (%d to %d free or clean frames): woke %lu times, "
+	       "scanned %lu frames, wrote %lu pages\n", cleaner_low,
+	       cleaner_high, wakeups, scanned, cleaned);
+	printf("Cleaner: %lu faults found a clean victim instead of a dirty "
+	       "one, %lu pages were written again first\n", cleaner_saved,
+	       cleaner_redirtied);
+	printf("Cleaner: modelled fault latency saved %.3f ms "
+	       "(%lu us per page write)\n",
+	       (double)cleaner_saved * write_us / 1000, write_us);
+}
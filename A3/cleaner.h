@@ -0,0 +1,19 @@
+#ifndef __CLEANER_H__
+#define __CLEANER_H__
+
+#include "pagetable.h"
+
+/* The background page cleaner for --cleaner LOW[,HIGH[,US]] (see
+ * cleaner.c). cleaner_run is called after a reference when fewer than LOW
+ * frames are free or clean. Pages it writes out are marked PG_CLEANED,
+ * and evict_page and mark_dirty count what became of them.
+ */
+extern int cleaner_low;                 // 0 if the cleaner is off
+extern unsigned long cleaner_saved;
+extern unsigned long cleaner_redirtied;
+
+extern int cleaner_configure(char *spec);
+extern void cleaner_run(void);
+extern void cleaner_report(void);
+
+#endif /* __CLEANER_H__ */
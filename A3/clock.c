@@ -4,6 +4,7 @@
 #include <getopt.h>
 #include <stdlib.h>
 #include "pagetable.h"
+#include "checkpoint.h"
 
 
 extern int memsize;
@@ -16,20 +17,71 @@ int arm;
 #define BIT_SET(a,b) ((a) |= (b))
 #define BIT_CLEAR(a,b) ((a) &= ~(b))
 
+// Reference bits, one per frame, packed 64 to a word. The hand reads these
+// instead of the PG_REF bit in each page's pte, which would mean chasing a
+// pointer into a different page table page for every frame it passes.
+#define REF_WORD_BITS 64
+static unsigned long *ref_bits;
+static int ref_words;
+static unsigned long last_word_mask; // Bits of the last word that are frames
+
+/* Mask of the bits at positions from..63 of a word. */
+static unsigned long bits_from(int from) {
+	return ~0UL << from;
+}
+
 /* Page to evict is chosen using the clock algorithm.
  * Returns the page frame number (which is also the index in the coremap)
  * for the page that is to be evicted.
+ *
+ * The hand moves a word at a time: it finds the first unreferenced frame at
+ * or after it in the word, and clears the reference bits of all the frames
+ * it skipped over in one go.
  */
 
 int clock_evict() {
+	int word = arm / REF_WORD_BITS;
+	int from = arm % REF_WORD_BITS;
+
 	while (1) {
-		if ((coremap[arm].pte->frame & PG_REF) == 0) {
+		unsigned long mask = bits_from(from);
+		unsigned long unref;
+
+		if (word == ref_words - 1) {
+			mask &= last_word_mask;
+		}
+		unref = ~ref_bits[word] & mask;
+		if (unref != 0) {
+			int bit = __builtin_ctzl(unref);
+			// Second chance for the referenced frames before it
+			BIT_CLEAR(ref_bits[word], mask & ~bits_from(bit));
+			arm = word * REF_WORD_BITS + bit;
 			return arm;
-		} else {
-			BIT_CLEAR(coremap[arm].pte->frame, PG_REF);
 		}
-		arm++;
-		arm = arm % memsize;
+		BIT_CLEAR(ref_bits[word], mask);
+		word = (word + 1) % ref_words;
+		from = 0;
+	}
+	return 0;
+}
+
+/* Like clock_evict, but the hand passes over frames that do not hold a page
+ * of process pid without touching their reference bits. It moves a frame
+ * at a time, since the frames it may take are scattered. The process must
+ * have at least one page in memory.
+ */
+int clock_evict_local(int pid) {
+	while (1) {
+		if (coremap[arm].pid == pid) {
+			unsigned long *word = &ref_bits[arm / REF_WORD_BITS];
+			unsigned long bit = 1UL << (arm % REF_WORD_BITS);
+
+			if (!(*word & bit)) {
+				return arm;
+			}
+			BIT_CLEAR(*word, bit);
+		}
+		arm = (arm + 1) % memsize;
 	}
 	return 0;
 }
@@ -39,7 +91,9 @@ int clock_evict() {
  * Input: The page table entry for the page that is being accessed.
  */
 void clock_ref(pgtbl_entry_t *p) {
-	BIT_SET(p->frame, PG_REF);
+	int frame = p->frame >> PAGE_SHIFT;
+
+	BIT_SET(ref_bits[frame / REF_WORD_BITS], 1UL << (frame % REF_WORD_BITS));
 	return;
 }
 
@@ -47,5 +101,24 @@ void clock_ref(pgtbl_entry_t *p) {
  * algorithm. 
  */
 void clock_init() {
+	int tail = memsize % REF_WORD_BITS;
+
 	arm = 0;
+	ref_words = (memsize + REF_WORD_BITS - 1) / REF_WORD_BITS;
+	ref_bits = calloc(ref_words, sizeof(unsigned long));
+	if (ref_bits == NULL) {
+		perror("Failed to allocate reference bitmap");
+		exit(1);
+	}
+	last_word_mask = tail == 0 ? ~0UL : (1UL << tail) - 1;
+}
+
+void clock_save(FILE *fp) {
+	ckpt_write(fp, &arm, sizeof(arm));
+	ckpt_write(fp, ref_bits, ref_words * sizeof(unsigned long));
+}
+
+void clock_load(FILE *fp) {
+	ckpt_read(fp, &arm, sizeof(arm));
+	ckpt_read(fp, ref_bits, ref_words * sizeof(unsigned long));
 }
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include "pagetable.h"
+#include "sim.h"
+#include "ilist.h"
+
+/* CLOCK-Pro (Jiang, Chen and Zhang, USENIX ATC 2005).
+ *
+ * An approximation of LIRS built on a clock. Resident pages are hot or
+ * cold. A cold page starts a test period when it is brought in, and keeps
+ * its place in the clock as a non-resident page after eviction until the
+ * test period ends. A page referenced during its test period has a small
+ * reuse distance and becomes hot. Three hands sweep the clock:
+ *  - HAND_cold evicts unreferenced cold pages, and promotes referenced
+ *    ones that are in their test period;
+ *  - HAND_hot demotes unreferenced hot pages, and ends the test periods
+ *    of the pages it passes;
+ *  - HAND_test ends test periods so that at most memsize non-resident
+ *    pages are remembered.
+ * The target number of cold frames adapts: it grows when a non-resident
+ * page in its test period is faulted in again, and shrinks when a test
+ * period ends without a re-access.
+ *
+ * Clock nodes are frame numbers for resident pages, or memsize + slot for
+ * non-resident pages in a ghost pool of memsize slots. New and promoted
+ * pages are placed at the list head, just behind HAND_hot.
+ */
+
+static struct ilist *clk;     // The clock, as a single list
+static struct ghost *test_pool; // Non-resident cold pages in test period
+static char *present;         // Whether each frame holds a page
+static char *hot;
+static char *referenced;
+static char *in_test;
+static int hand_hot, hand_cold, hand_test;
+static int num_hot, num_cold, num_nonres;
+static int cold_target;       // mc in the paper
+
+/* The node after n going around the clock, skipping the sentinel. */
+static int clock_next(int n) {
+	int next = clk->next[n];
+	if (next == clk->nnodes) {
+		next = clk->next[next];
+	}
+	return next;
+}
+
+/* Takes node n off the clock, first moving any hand pointing at it on. */
+static void clock_remove(int n) {
+	int next = clock_next(n);
+	if (next == n) {
+		next = -1;
+	}
+	if (hand_hot == n) {
+		hand_hot = next;
+	}
+	if (hand_cold == n) {
+		hand_cold = next;
+	}
+	if (hand_test == n) {
+		hand_test = next;
+	}
+	ilist_remove(clk, n);
+}
+
+/* Puts node n at the list head, just behind HAND_hot. */
+static void clock_insert(int n) {
+	if (clk->size[0] == 0) {
+		ilist_push(clk, 0, n);
+		hand_hot = hand_cold = hand_test = n;
+	} else {
+		ilist_insert_before(clk, hand_hot, n);
+	}
+}
+
+static void shrink_cold_target() {
+	if (cold_target > 1) {
+		cold_target--;
+	}
+}
+
+/* Ends the test period of the non-resident page at clock node n. */
+static void forget_nonres(int n) {
+	clock_remove(n);
+	ghost_remove(test_pool, n - memsize);
+	num_nonres--;
+	shrink_cold_target();
+}
+
+/* Runs HAND_hot until it has demoted one hot page to cold. */
+static void run_hand_hot() {
+	while (num_hot > 0) {
+		int n = hand_hot;
+
+		if (n >= memsize) {
+			forget_nonres(n);
+			continue;
+		}
+		hand_hot = clock_next(n);
+		if (hot[n]) {
+			if (referenced[n]) {
+				referenced[n] = 0;
+			} else {
+				hot[n] = 0;
+				in_test[n] = 0;
+				num_hot--;
+				num_cold++;
+				return;
+			}
+		} else if (in_test[n] && !referenced[n]) {
+			in_test[n] = 0;
+			shrink_cold_target();
+		}
+	}
+}
+
+/* Runs HAND_test until it has forgotten one non-resident page. */
+static void run_hand_test() {
+	while (num_nonres > 0) {
+		int n = hand_test;
+
+		if (n >= memsize) {
+			forget_nonres(n);
+			return;
+		}
+		hand_test = clock_next(n);
+		if (!hot[n] && in_test[n] && !referenced[n]) {
+			in_test[n] = 0;
+			shrink_cold_target();
+		}
+	}
+}
+
+/* Keeps the number of hot pages within memsize - cold_target. */
+static void balance_hot() {
+	while (num_hot > 0 && num_hot > (int)memsize - cold_target) {
+		run_hand_hot();
+	}
+}
+
+/* Page to evict is chosen using the CLOCK-Pro algorithm.
+ * Returns the page frame number (which is also the index in the coremap)
+ * for the page that is to be evicted.
+ */
+int clockpro_evict() {
+	while (1) {
+		int n;
+
+		if (num_cold == 0) {
+			run_hand_hot();
+		}
+		n = hand_cold;
+		if (n >= memsize || hot[n]) {
+			hand_cold = clock_next(n);
+			continue;
+		}
+
+		if (!referenced[n]) {
+			present[n] = 0;
+			num_cold--;
+			if (in_test[n]) {
+				// Keep its place in the clock until the test ends
+				int slot;
+				if (num_nonres >= memsize) {
+					run_hand_test();
+				}
+				slot = ghost_add(test_pool, 0, coremap[n].pte);
+				ilist_replace(clk, n, memsize + slot);
+				if (hand_hot == n) {
+					hand_hot = memsize + slot;
+				}
+				if (hand_test == n) {
+					hand_test = memsize + slot;
+				}
+				hand_cold = clock_next(memsize + slot);
+				num_nonres++;
+			} else {
+				clock_remove(n);
+			}
+			return n;
+		}
+
+		// Referenced: promote it if in its test period, otherwise start
+		// a new test period. Either way it moves to the list head.
+		referenced[n] = 0;
+		clock_remove(n);
+		clock_insert(n);
+		if (in_test[n]) {
+			hot[n] = 1;
+			in_test[n] = 0;
+			num_cold--;
+			num_hot++;
+			balance_hot();
+		} else {
+			in_test[n] = 1;
+		}
+	}
+}
+
+/* This function is called on each access to a page to update any information
+ * needed by the CLOCK-Pro algorithm.
+ * Input: The page table entry for the page that is being accessed.
+ */
+void clockpro_ref(pgtbl_entry_t *p) {
+	int frame = p->frame >> PAGE_SHIFT;
+	int slot;
+
+	if (present[frame]) {
+		referenced[frame] = 1;
+		return;
+	}
+
+	present[frame] = 1;
+	referenced[frame] = 0;
+	slot = ghost_find(test_pool, p);
+	if (slot != -1) {
+		// Faulted in again during its test period: it is hot, and cold
+		// pages deserve more room
+		clock_remove(memsize + slot);
+		ghost_remove(test_pool, slot);
+		num_nonres--;
+		if (cold_target < (int)memsize - 1) {
+			cold_target++;
+		}
+		hot[frame] = 1;
+		in_test[frame] = 0;
+		num_hot++;
+		clock_insert(frame);
+		balance_hot();
+	} else {
+		hot[frame] = 0;
+		in_test[frame] = 1;
+		num_cold++;
+		clock_insert(frame);
+	}
+}
+
+/* Initialize any data structures needed for this
+ * replacement algorithm
+ */
+void clockpro_init() {
+	clk = ilist_create(2 * memsize, 1);
+	test_pool = ghost_create(memsize, 1);
+	present = calloc(memsize, sizeof(char));
+	hot = calloc(memsize, sizeof(char));
+	referenced = calloc(memsize, sizeof(char));
+	in_test = calloc(memsize, sizeof(char));
+	if (present == NULL || hot == NULL || referenced == NULL ||
+	    in_test == NULL) {
+		perror("Failed to allocate CLOCK-Pro state");
+		exit(1);
+	}
+	hand_hot = hand_cold = hand_test = -1;
+	num_hot = num_cold = num_nonres = 0;
+	cold_target = memsize / 4 > 0 ? memsize / 4 : 1;
+}
@@ -4,6 +4,7 @@
 #include <getopt.h>
 #include <stdlib.h>
 #include "pagetable.h"
+#include "checkpoint.h"
 
 
 extern int memsize;
@@ -12,14 +13,49 @@ extern int debug;
 
 extern struct frame *coremap;
 
-int curr;
+/* The FIFO queue is a circular doubly-linked list of frame numbers in the
+ * order their pages were loaded, stored as two index arrays parallel to
+ * the coremap, as for LRU. Entry memsize is a sentinel whose next is the
+ * oldest frame and whose prev is the newest. A frame joins the tail the
+ * first time its page is referenced (or filled) after it was loaded, and
+ * is not on the list (next == -1) from its eviction until then. Keeping
+ * the order in a list rather than as a cursor over the coremap means a
+ * local eviction can take the oldest page of one process without
+ * reordering the pages of the others.
+ */
+static int *fifo_next;
+static int *fifo_prev;
+static int sentinel;
+
+static inline void fifo_unlink(int frame) {
+	fifo_next[fifo_prev[frame]] = fifo_next[frame];
+	fifo_prev[fifo_next[frame]] = fifo_prev[frame];
+	fifo_next[frame] = -1;
+}
+
 /* Page to evict is chosen using the fifo algorithm.
  * Returns the page frame number (which is also the index in the coremap)
  * for the page that is to be evicted.
  */
 int fifo_evict() {
-	int result = curr;
-	curr++;
+	int result = fifo_next[sentinel];
+
+	assert(result != sentinel);
+	fifo_unlink(result);
+	return result;
+}
+
+/* Evicts the oldest page of process pid, which must have at least one page
+ * in memory.
+ */
+int fifo_evict_local(int pid) {
+	int result = fifo_next[sentinel];
+
+	while (coremap[result].pid != pid) {
+		result = fifo_next[result];
+		assert(result != sentinel);
+	}
+	fifo_unlink(result);
 	return result;
 }
 
@@ -28,13 +64,44 @@ int fifo_evict() {
  * Input: The page table entry for the page that is being accessed.
  */
 void fifo_ref(pgtbl_entry_t *p) {
-	curr = curr % memsize;
-	return;
+	int fn = p->frame >> PAGE_SHIFT;
+
+	if (fifo_next[fn] != -1) {
+		return; // Already queued; a hit does not move it
+	}
+	// Newly loaded: append at the tail, right before the sentinel
+	fifo_prev[fn] = fifo_prev[sentinel];
+	fifo_next[fn] = sentinel;
+	fifo_next[fifo_prev[sentinel]] = fn;
+	fifo_prev[sentinel] = fn;
 }
 
 /* Initialize any data structures needed for this 
  * replacement algorithm 
  */
 void fifo_init() {
-	curr = 0;
+	int i;
+
+	sentinel = memsize;
+	fifo_next = malloc((memsize + 1) * sizeof(int));
+	fifo_prev = malloc((memsize + 1) * sizeof(int));
+	if (fifo_next == NULL || fifo_prev == NULL) {
+		perror("Failed to allocate FIFO list");
+		exit(1);
+	}
+	for (i = 0; i < memsize; i++) {
+		fifo_next[i] = -1;
+	}
+	fifo_next[sentinel] = sentinel;
+	fifo_prev[sentinel] = sentinel;
+}
+
+void fifo_save(FILE *fp) {
+	ckpt_write(fp, fifo_next, (memsize + 1) * sizeof(int));
+	ckpt_write(fp, fifo_prev, (memsize + 1) * sizeof(int));
+}
+
+void fifo_load(FILE *fp) {
+	ckpt_read(fp, fifo_next, (memsize + 1) * sizeof(int));
+	ckpt_read(fp, fifo_prev, (memsize + 1) * sizeof(int));
 }
@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "pagetable.h"
+#include "sim.h"
+#include "pagemap.h"
+#include "huge.h"
+
+/* Huge page (2 MiB) mode, enabled with --huge N.
+ *
+ * This models transparent huge pages on top of the radix page table. A
+ * fault in a 2 MiB region that leaves N of its 512 subpages resident
+ * promotes the region (like khugepaged, which only collapses a region
+ * when at most 512 - N of its ptes are empty): every subpage that is not
+ * resident is brought in (from swap, or zero-filled) as part of that one
+ * fault, and the level 1 entry for the region is marked PG_HUGE so that it
+ * maps the whole region. The subpages keep their page table entries and frames, as
+ * the simulator needs them to track contents and swap slots, but they
+ * count as a single page table entry while the region is huge.
+ *
+ * Only 4 KiB pages are evicted. When the replacement algorithm picks a
+ * frame holding part of a huge page, the huge page is split back into
+ * subpages first, as Linux does when reclaiming a huge page. A huge page
+ * has one dirty bit, so if any subpage was written while it was huge,
+ * every subpage is dirty after the split.
+ *
+ * A region that has just been split, or whose promotion failed, is likely
+ * to be under memory pressure, and promoting it again straight away would
+ * only bring in subpages for the next eviction to split off. So it is left
+ * alone for its next HUGE_SUBPAGES faults, twice as many after each
+ * further split or failure, up to HUGE_BACKOFF_MAX.
+ *
+ * Frames are not required to be physically contiguous, so there is no
+ * external fragmentation to report. What is reported is the internal
+ * fragmentation: subpages that were mapped by a huge page and never
+ * referenced while it was.
+ */
+
+#define HUGE_SHIFT     21
+#define HUGE_SUBPAGES  (1 << (HUGE_SHIFT - PAGE_SHIFT))
+#define SUBPAGE_WORDS  (HUGE_SUBPAGES / 64)
+#define HUGE_BACKOFF_MAX (64 * HUGE_SUBPAGES)
+
+// Regions of different processes are told apart by the pid above the
+// region number
+#define REGION_KEY(pid, vaddr) \
+	(((unsigned long)(pid) << (TRACE_VADDR_BITS - HUGE_SHIFT)) | \
+	 ((vaddr) >> HUGE_SHIFT))
+
+int huge_threshold = 0;       // N, or 0 if huge pages are off
+
+struct region {
+	unsigned long used[SUBPAGE_WORDS];    // Referenced while huge
+	pgtbl_entry_t *ptes;          // The region's 512 ptes, once promoted
+	int backoff;                  // Faults to go before it may be promoted
+	int penalty;                  // What backoff was last set to
+	char huge;
+	char dirty;                   // Written while huge
+};
+
+static struct region *regions;
+static int num_regions, regions_cap;
+static struct pagemap *region_index; // REGION_KEY -> regions[]
+static int num_huge = 0;
+
+static unsigned long promotions = 0;
+static unsigned long failed_promotions = 0;
+static unsigned long splits = 0;
+static unsigned long promotion_fills = 0; // Subpages brought in by promotion
+static unsigned long failed_fills = 0;    // ... by promotions that failed
+static unsigned long huge_subpages = 0;   // Subpages mapped by huge pages
+static unsigned long unused_subpages = 0; // ... never referenced meanwhile
+static unsigned long long pte_sum = 0;    // Entries in use, summed per ref
+static unsigned long long pte_sum_small = 0; // The same with 4 KiB only
+
+/* Returns the region of the current process containing vaddr, creating
+ * it if needed.
+ */
+static struct region *get_region(addr_t vaddr) {
+	long *idx;
+
+	if (region_index == NULL) {
+		region_index = pagemap_create(1024);
+	}
+	idx = pagemap_lookup(region_index, REGION_KEY(curproc->pid, vaddr));
+	if (idx != NULL) {
+		return &regions[*idx];
+	}
+	if (num_regions == regions_cap) {
+		regions_cap = regions_cap ? 2 * regions_cap : 1024;
+		regions = realloc(regions, regions_cap * sizeof(struct region));
+		if (regions == NULL) {
+			perror("Failed to allocate huge page regions");
+			exit(1);
+		}
+	}
+	memset(&regions[num_regions], 0, sizeof(struct region));
+	pagemap_insert(region_index, REGION_KEY(curproc->pid, vaddr),
+		       num_regions);
+	return &regions[num_regions++];
+}
+
+/* Marks subpage i as set in bits, returning 1 if it was not already. */
+static int set_subpage(unsigned long *bits, int i) {
+	unsigned long mask = 1UL << (i % 64);
+
+	if (bits[i / 64] & mask) {
+		return 0;
+	}
+	bits[i / 64] |= mask;
+	return 1;
+}
+
+static int count_subpages(unsigned long *bits) {
+	int i, n = 0;
+
+	for (i = 0; i < SUBPAGE_WORDS; i++) {
+		n += __builtin_popcountl(bits[i]);
+	}
+	return n;
+}
+
+/* Records that the subpages of a huge page are going back to being
+ * mapped one at a time.
+ */
+static void end_huge(struct region *r) {
+	huge_subpages += HUGE_SUBPAGES;
+	unused_subpages += HUGE_SUBPAGES - count_subpages(r->used);
+	memset(r->used, 0, sizeof(r->used));
+	r->huge = 0;
+	num_huge--;
+}
+
+/* Holds off promoting r again after a split or a failed promotion. */
+static void back_off(struct region *r) {
+	r->penalty = r->penalty ? 2 * r->penalty : HUGE_SUBPAGES;
+	if (r->penalty > HUGE_BACKOFF_MAX) {
+		r->penalty = HUGE_BACKOFF_MAX;
+	}
+	r->backoff = r->penalty;
+}
+
+/* Called on a fault on p at vaddr. If this fault promotes the region, all
+ * of its subpages (p included) are brought into memory and 1 is returned.
+ * Otherwise 0 is returned and p should be paged in as usual.
+ */
+int huge_fault(addr_t vaddr, pgtbl_entry_t *p) {
+	struct region *r = get_region(vaddr);
+	int i = (vaddr >> PAGE_SHIFT) % HUGE_SUBPAGES;
+	addr_t base = vaddr & ~((1UL << HUGE_SHIFT) - 1);
+	pgtbl_entry_t *first = p - i;   // The region's 512 ptes are adjacent
+	int resident = 1;               // p, once this fault is done
+	int fills = 0;
+
+	if (r->huge || memsize < 2 * HUGE_SUBPAGES) {
+		return 0;
+	}
+	if (r->backoff > 0) {
+		r->backoff--;
+		return 0;
+	}
+	for (i = 0; i < HUGE_SUBPAGES; i++) {
+		if (first[i].frame & PG_VALID) {
+			resident++;
+		}
+	}
+	if (resident < huge_threshold) {
+		return 0;
+	}
+
+	for (i = 0; i < HUGE_SUBPAGES; i++) {
+		if (!(first[i].frame & PG_VALID)) {
+			page_in(&first[i], base + ((addr_t)i << PAGE_SHIFT));
+			if (&first[i] != p) {
+				// Let the replacement algorithm know about it
+				fill_fcn(&first[i]);
+				fills++;
+			}
+		}
+	}
+	if (!(p->frame & PG_VALID)) {
+		// Bringing in the rest of the region pushed out this page, and
+		// its reference will be seen by the replacement algorithm
+		page_in(p, vaddr);
+	}
+	// Filling the region may also have evicted some of its own subpages
+	for (i = 0; i < HUGE_SUBPAGES; i++) {
+		if (!(first[i].frame & PG_VALID)) {
+			failed_promotions++;
+			failed_fills += fills;
+			back_off(r);
+			return 1;
+		}
+	}
+
+	r->ptes = first;
+	r->huge = 1;
+	r->dirty = 0;
+	num_huge++;
+	promotions++;
+	promotion_fills += fills;
+	set_pmd_huge(curproc->pid, vaddr, 1);
+	return 1;
+}
+
+/* Called on every reference once the page at vaddr is resident. */
+void huge_ref(addr_t vaddr, char type) {
+	struct region *r = get_region(vaddr);
+	int i = (vaddr >> PAGE_SHIFT) % HUGE_SUBPAGES;
+	unsigned long resident = frames_in_use();
+
+	if (r->huge) {
+		set_subpage(r->used, i);
+		if (type == 'M' || type == 'S') {
+			r->dirty = 1;
+		}
+	}
+
+	pte_sum += resident - (unsigned long)num_huge * (HUGE_SUBPAGES - 1);
+	pte_sum_small += resident;
+}
+
+/* Splits the huge page containing vaddr in process pid, if there is one,
+ * before one of its subpages is evicted.
+ */
+void huge_split(int pid, addr_t vaddr) {
+	long *idx = region_index ?
+		pagemap_lookup(region_index, REGION_KEY(pid, vaddr)) : NULL;
+	struct region *r;
+	pgtbl_entry_t *first;
+	int i;
+
+	if (idx == NULL || !regions[*idx].huge) {
+		return;
+	}
+	r = &regions[*idx];
+	first = r->ptes;
+
+	if (r->dirty) {
+		// The huge page had one dirty bit, covering every subpage
+		for (i = 0; i < HUGE_SUBPAGES; i++) {
+			assert(first[i].frame & PG_VALID);
+			mark_dirty(&first[i]);
+			if (first[i].swap_off != INVALID_SWAP) {
+				swap_free(first[i].swap_off);
+				first[i].swap_off = INVALID_SWAP;
+			}
+		}
+	}
+	end_huge(r);
+	back_off(r);
+	splits++;
+	set_pmd_huge(pid, vaddr, 0);
+}
+
+void huge_report() {
+	int i;
+
+	if (!huge_threshold) {
+		return;
+	}
+	// Huge pages still mapped at the end count towards fragmentation too
+	for (i = 0; i < num_regions; i++) {
+		if (regions[i].huge) {
+			end_huge(&regions[i]);
+		}
+	}
+	printf("Huge pages: %lu promotions (threshold %d of %d), %lu failed, "
+	       "%lu splits, %lu subpages brought in by promotion (%lu more by "
+	       "failed ones)\n", promotions, huge_threshold, HUGE_SUBPAGES,
+	       failed_promotions, splits, promotion_fills, failed_fills);
+	printf("Huge page fragmentation: %lu of %lu subpages mapped by huge "
+	       "pages were never referenced (%.4f%%)\n",
+	       unused_subpages, huge_subpages,
+	       huge_subpages ? (double)unused_subpages / huge_subpages * 100 : 0.0);
+	printf("Page table entries in use: %.1f on average, against %.1f with "
+	       "4 KiB pages only (%.4f%% fewer)\n",
+	       (double)pte_sum / ref_count, (double)pte_sum_small / ref_count,
+	       pte_sum_small ?
+	       (double)(pte_sum_small - pte_sum) / pte_sum_small * 100 : 0.0);
+}
@@ -0,0 +1,17 @@
+#ifndef __HUGE_H__
+#define __HUGE_H__
+
+#include "pagetable.h"
+
+/* Transparent huge pages for --huge N (see huge.c). huge_fault may promote
+ * the faulting page's 2 MiB region, and huge_split must be called before a
+ * subpage of a huge page is evicted.
+ */
+extern int huge_threshold;     // N, or 0 if huge pages are off
+
+extern int huge_fault(addr_t vaddr, pgtbl_entry_t *p);
+extern void huge_ref(addr_t vaddr, char type);
+extern void huge_split(int pid, addr_t vaddr);
+extern void huge_report(void);
+
+#endif /* __HUGE_H__ */
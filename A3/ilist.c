@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "ilist.h"
+#include "pagemap.h"
+
+struct ilist *ilist_create(int nnodes, int nlists) {
+	struct ilist *l = malloc(sizeof(struct ilist));
+	int total = nnodes + nlists;
+	int i;
+
+	if (l == NULL) {
+		perror("Failed to allocate list");
+		exit(1);
+	}
+	l->nnodes = nnodes;
+	l->nlists = nlists;
+	l->next = malloc(total * sizeof(int));
+	l->prev = malloc(total * sizeof(int));
+	l->which = malloc(nnodes * sizeof(int));
+	l->size = calloc(nlists, sizeof(int));
+	if (l->next == NULL || l->prev == NULL || l->which == NULL ||
+	    l->size == NULL) {
+		perror("Failed to allocate list");
+		exit(1);
+	}
+	for (i = 0; i < nnodes; i++) {
+		l->which[i] = -1;
+	}
+	for (i = nnodes; i < total; i++) {
+		l->next[i] = i;
+		l->prev[i] = i;
+	}
+	return l;
+}
+
+/* Inserts node at the head of list. The node must not be on any list. */
+void ilist_push(struct ilist *l, int list, int node) {
+	int s = l->nnodes + list;
+
+	assert(l->which[node] == -1);
+	l->next[node] = l->next[s];
+	l->prev[node] = s;
+	l->prev[l->next[s]] = node;
+	l->next[s] = node;
+	l->which[node] = list;
+	l->size[list]++;
+}
+
+void ilist_remove(struct ilist *l, int node) {
+	assert(l->which[node] != -1);
+	l->next[l->prev[node]] = l->next[node];
+	l->prev[l->next[node]] = l->prev[node];
+	l->size[l->which[node]]--;
+	l->which[node] = -1;
+}
+
+/* Puts node in the place of old, which leaves its list. */
+void ilist_replace(struct ilist *l, int old, int node) {
+	assert(l->which[old] != -1 && l->which[node] == -1);
+	l->next[node] = l->next[old];
+	l->prev[node] = l->prev[old];
+	l->next[l->prev[old]] = node;
+	l->prev[l->next[old]] = node;
+	l->which[node] = l->which[old];
+	l->which[old] = -1;
+}
+
+/* Inserts node just ahead of 'at', on the same list. */
+void ilist_insert_before(struct ilist *l, int at, int node) {
+	assert(l->which[at] != -1 && l->which[node] == -1);
+	l->next[node] = at;
+	l->prev[node] = l->prev[at];
+	l->next[l->prev[at]] = node;
+	l->prev[at] = node;
+	l->which[node] = l->which[at];
+	l->size[l->which[at]]++;
+}
+
+/* Returns the most recently pushed node of list, or -1 if it is empty. */
+int ilist_head(struct ilist *l, int list) {
+	int s = l->nnodes + list;
+	return l->next[s] == s ? -1 : l->next[s];
+}
+
+/* Returns the oldest node of list, or -1 if it is empty. */
+int ilist_tail(struct ilist *l, int list) {
+	int s = l->nnodes + list;
+	return l->prev[s] == s ? -1 : l->prev[s];
+}
+
+//---------------------------------------------------------------------
+// Ghost lists
+
+struct ghost *ghost_create(int nslots, int nlists) {
+	struct ghost *g = malloc(sizeof(struct ghost));
+	int i;
+
+	if (g == NULL) {
+		perror("Failed to allocate ghost list");
+		exit(1);
+	}
+	g->l = ilist_create(nslots, nlists);
+	g->pte = malloc(nslots * sizeof(pgtbl_entry_t *));
+	g->free = malloc(nslots * sizeof(int));
+	if (g->pte == NULL || g->free == NULL) {
+		perror("Failed to allocate ghost list");
+		exit(1);
+	}
+	for (i = 0; i < nslots; i++) {
+		g->free[i] = nslots - 1 - i;
+	}
+	g->nfree = nslots;
+	g->map = pagemap_create(nslots);
+	return g;
+}
+
+/* Returns the slot remembering pte, or -1 if it is not a ghost. */
+int ghost_find(struct ghost *g, pgtbl_entry_t *pte) {
+	long *slot = pagemap_lookup(g->map, (unsigned long)pte);
+	return slot == NULL ? -1 : (int)*slot;
+}
+
+/* Remembers pte at the head of the given ghost list.
+ * Returns its slot, or -1 if every slot is in use.
+ */
+int ghost_add(struct ghost *g, int list, pgtbl_entry_t *pte) {
+	int slot;
+
+	if (g->nfree == 0) {
+		return -1;
+	}
+	slot = g->free[--g->nfree];
+	g->pte[slot] = pte;
+	pagemap_insert(g->map, (unsigned long)pte, slot);
+	ilist_push(g->l, list, slot);
+	return slot;
+}
+
+/* Forgets the page in slot, taking it off its ghost list if it is on one. */
+void ghost_remove(struct ghost *g, int slot) {
+	if (g->l->which[slot] != -1) {
+		ilist_remove(g->l, slot);
+	}
+	pagemap_remove(g->map, (unsigned long)g->pte[slot]);
+	g->free[g->nfree++] = slot;
+}
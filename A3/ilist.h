@@ -0,0 +1,50 @@
+#ifndef __ILIST_H__
+#define __ILIST_H__
+
+#include "pagetable.h"
+#include "pagemap.h"
+
+/* Index lists: doubly-linked lists whose nodes are small integers (frame
+ * numbers, or slots in a ghost pool) rather than heap-allocated structs.
+ * All links live in arrays allocated once, so moving a node between lists
+ * never allocates. A set of nlists lists shares one pool of nnodes nodes,
+ * and each node is on at most one of them at a time. Node nnodes+k is the
+ * sentinel of list k; its next is the head (most recent) and its prev is
+ * the tail (oldest).
+ */
+struct ilist {
+	int nnodes;
+	int nlists;
+	int *next;
+	int *prev;
+	int *which;   // List each node is on, or -1
+	int *size;    // Number of nodes on each list
+};
+
+extern struct ilist *ilist_create(int nnodes, int nlists);
+extern void ilist_push(struct ilist *l, int list, int node);
+extern void ilist_remove(struct ilist *l, int node);
+extern void ilist_replace(struct ilist *l, int old, int node);
+extern void ilist_insert_before(struct ilist *l, int at, int node);
+extern int ilist_head(struct ilist *l, int list);
+extern int ilist_tail(struct ilist *l, int list);
+
+/* Ghost lists remember pages that are no longer resident (identified by
+ * their page table entry) in a fixed-size pool of slots, for policies
+ * such as ARC, 2Q and LIRS that use recent eviction history. The slots
+ * are nodes of an ilist, so ghosts can be kept on several lists.
+ */
+struct ghost {
+	struct ilist *l;
+	pgtbl_entry_t **pte;   // Page remembered in each slot
+	int *free;             // Stack of unused slots
+	int nfree;
+	struct pagemap *map;   // pte -> slot
+};
+
+extern struct ghost *ghost_create(int nslots, int nlists);
+extern int ghost_find(struct ghost *g, pgtbl_entry_t *pte);
+extern int ghost_add(struct ghost *g, int list, pgtbl_entry_t *pte);
+extern void ghost_remove(struct ghost *g, int slot);
+
+#endif /* __ILIST_H__ */
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "pagemap.h"
+#include "interval.h"
+
+/* The interval reporter (--interval N[,csv|bin]) writes a row every N
+ * references, so that phases of the trace show up: the window's miss
+ * rate, the clean and dirty evictions in it, how many distinct pages it
+ * touched, and how full memory and swap are at its end.
+ *
+ * The counters are the simulator's own, sampled at each window boundary.
+ * Distinct pages are counted with a map from each page to the last window
+ * it was referenced in, so a page is counted the first time it is seen in
+ * a window and the map never needs clearing.
+ */
+
+unsigned long interval_refs = 0;
+
+static int binary;
+static FILE *out;
+static struct pagemap *last_window;  // Page -> window it was last seen in
+static long window;
+static uint64_t total;               // References so far
+static unsigned long win_refs;
+static unsigned long win_distinct;
+static unsigned long start_miss, start_clean, start_dirty;
+
+/* Parses "N[,csv|bin]". Returns 0 on success, -1 if spec is invalid. */
+int interval_configure(char *spec) {
+	char *end;
+
+	interval_refs = strtoul(spec, &end, 10);
+	if (interval_refs == 0 || interval_refs > UINT32_MAX) {
+		return -1;
+	}
+	binary = 0;
+	if (*end == '\0') {
+		return 0;
+	}
+	if (strcmp(end, ",csv") == 0) {
+		return 0;
+	}
+	if (strcmp(end, ",bin") == 0) {
+		binary = 1;
+		return 0;
+	}
+	return -1;
+}
+
+/* Opens filename (NULL or "-" for stdout) and writes the CSV header line
+ * or the binary header. Binary output must go to a file.
+ */
+void interval_open(char *filename, unsigned swapsize) {
+	struct interval_header hdr;
+
+	if (filename == NULL || strcmp(filename, "-") == 0) {
+		if (binary) {
+			fprintf(stderr, "Error: binary --interval output needs "
+				"--interval-file\n");
+			exit(1);
+		}
+		out = stdout;
+	} else if ((out = fopen(filename, binary ? "wb" : "w")) == NULL) {
+		perror("Error opening interval file");
+		exit(1);
+	}
+
+	last_window = pagemap_create(1024);
+	window = 0;
+	total = 0;
+	win_refs = win_distinct = 0;
+	start_miss = start_clean = start_dirty = 0;
+
+	if (binary) {
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, INTERVAL_MAGIC, INTERVAL_MAGIC_LEN);
+		hdr.version = INTERVAL_VERSION;
+		hdr.record_size = sizeof(struct interval_record);
+		hdr.interval = interval_refs;
+		hdr.memsize = memsize;
+		hdr.swap_slots = swapsize;
+		if (fwrite(&hdr, sizeof(hdr), 1, out) != 1) {
+			perror("Error writing interval file");
+			exit(1);
+		}
+	} else {
+		fprintf(out, "end,refs,misses,miss_rate,evict_clean,evict_dirty,"
+			"distinct_pages,resident,swap_used\n");
+	}
+}
+
+/* Writes the row for the window that has just ended and starts the next. */
+static void interval_emit() {
+	struct interval_record r;
+
+	memset(&r, 0, sizeof(r));
+	r.end = total;
+	r.refs = win_refs;
+	r.misses = miss_count - start_miss;
+	r.evict_clean = evict_clean_count - start_clean;
+	r.evict_dirty = evict_dirty_count - start_dirty;
+	r.distinct_pages = win_distinct;
+	r.resident = frames_in_use();
+	r.swap_used = swap_slots_in_use();
+
+	if (binary) {
+		if (fwrite(&r, sizeof(r), 1, out) != 1) {
+			perror("Error writing interval file");
+			exit(1);
+		}
+	} else {
+		fprintf(out, "%lu,%u,%u,%.4f,%u,%u,%u,%u,%u\n",
+			(unsigned long)r.end, r.refs, r.misses,
+			(double)r.misses / r.refs * 100, r.evict_clean,
+			r.evict_dirty, r.distinct_pages, r.resident, r.swap_used);
+	}
+
+	window++;
+	win_refs = win_distinct = 0;
+	start_miss = miss_count;
+	start_clean = evict_clean_count;
+	start_dirty = evict_dirty_count;
+}
+
+/* Called after each reference has been simulated. */
+void interval_ref(int pid, addr_t vaddr) {
+	unsigned long page = TRACE_PAGE(pid, vaddr);
+	long *seen = pagemap_lookup(last_window, page);
+
+	if (seen == NULL) {
+		pagemap_insert(last_window, page, window);
+		win_distinct++;
+	} else if (*seen != window) {
+		*seen = window;
+		win_distinct++;
+	}
+	total++;
+	if (++win_refs == interval_refs) {
+		interval_emit();
+	}
+}
+
+/* Writes the row for the partial window at the end of the trace, if any,
+ * and closes the output.
+ */
+void interval_close() {
+	if (win_refs > 0) {
+		interval_emit();
+	}
+	if (out != stdout) {
+		if (fclose(out) != 0) {
+			perror("Error writing interval file");
+			exit(1);
+		}
+	} else {
+		fflush(out);
+	}
+	pagemap_destroy(last_window);
+	last_window = NULL;
+}
@@ -0,0 +1,47 @@
+#ifndef __INTERVAL_H__
+#define __INTERVAL_H__
+
+#include <stdint.h>
+#include "pagetable.h"
+
+/* Time series of the simulation for --interval. Every N references a row
+ * is written with what happened in that window, as CSV with a header line,
+ * or in the binary format below. The last row covers whatever is left of
+ * the trace, so it may be shorter than N.
+ *
+ * The binary file is an interval_header followed by one interval_record
+ * per window, all in host byte order.
+ */
+#define INTERVAL_MAGIC     "\177SIMIVL"
+#define INTERVAL_MAGIC_LEN 8
+#define INTERVAL_VERSION   1
+
+struct interval_header {
+	char magic[INTERVAL_MAGIC_LEN];
+	uint32_t version;
+	uint32_t record_size;     // sizeof(struct interval_record)
+	uint64_t interval;        // N
+	uint32_t memsize;         // Frames of physical memory
+	uint32_t swap_slots;      // Pages the swapfile holds
+};
+
+struct interval_record {
+	uint64_t end;             // References replayed at the end of the window
+	uint32_t refs;            // References in the window
+	uint32_t misses;
+	uint32_t evict_clean;
+	uint32_t evict_dirty;
+	uint32_t distinct_pages;  // Pages referenced in the window
+	uint32_t resident;        // Frames in use at the end of the window
+	uint32_t swap_used;       // Swap slots in use at the end of the window
+	uint32_t reserved;
+};
+
+extern unsigned long interval_refs;   // N, or 0 when --interval is off
+
+extern int interval_configure(char *spec);
+extern void interval_open(char *filename, unsigned swapsize);
+extern void interval_ref(int pid, addr_t vaddr);
+extern void interval_close(void);
+
+#endif /* __INTERVAL_H__ */
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include "pagetable.h"
+#include "sim.h"
+#include "ilist.h"
+
+/* LIRS, Low Inter-reference Recency Set (Jiang and Zhang, SIGMETRICS 2002).
+ *
+ * Pages are ranked by the recency of their previous reuse rather than of
+ * their last use. Most of memory holds LIR pages, which have been reused
+ * within a short distance. The rest (Lhirs frames, 1% here) holds HIR
+ * pages, and only HIR pages are ever evicted, so a scan cannot displace
+ * the LIR set.
+ *
+ * The stack S orders LIR pages, resident HIR pages and non-resident HIR
+ * pages by recency, and is pruned so its bottom is always a LIR page. A
+ * HIR page that is referenced while still in S has a smaller reuse
+ * distance than the bottom LIR page and swaps status with it. The queue Q
+ * holds the resident HIR pages in eviction order.
+ *
+ * Nodes of S are frame numbers for resident pages, or memsize + slot for
+ * non-resident pages kept in a ghost pool of memsize slots. When the pool
+ * is full the oldest non-resident page is forgotten, which bounds S.
+ */
+
+static struct ilist *stack;   // S, over frames and ghost nodes
+static struct ilist *queue;   // Q, over frame numbers
+static struct ghost *nonres;  // Non-resident HIR pages in S, oldest last
+static char *is_lir;          // Whether the page in each frame is LIR
+static char *present;         // Whether each frame holds a page for LIRS
+static int num_lir;
+static int max_lir;           // Llirs
+
+/* Moves node to the top of S. */
+static void stack_top(int node) {
+	if (stack->which[node] != -1) {
+		ilist_remove(stack, node);
+	}
+	ilist_push(stack, 0, node);
+}
+
+/* Removes HIR pages from the bottom of S until a LIR page is there. */
+static void prune() {
+	int node;
+
+	while ((node = ilist_tail(stack, 0)) != -1 &&
+	       (node >= memsize || !is_lir[node])) {
+		ilist_remove(stack, node);
+		if (node >= memsize) {
+			ghost_remove(nonres, node - memsize);
+		}
+	}
+}
+
+/* Turns the LIR page at the bottom of S into a resident HIR page. */
+static void demote_bottom() {
+	int frame;
+
+	// With a tiny memory there may be no other LIR page holding the
+	// bottom of S in place, so prune first
+	prune();
+	frame = ilist_tail(stack, 0);
+
+	assert(frame != -1 && frame < memsize && is_lir[frame]);
+	ilist_remove(stack, frame);
+	is_lir[frame] = 0;
+	num_lir--;
+	ilist_push(queue, 0, frame);
+	prune();
+}
+
+/* Page to evict is chosen using the LIRS algorithm.
+ * Returns the page frame number (which is also the index in the coremap)
+ * for the page that is to be evicted.
+ */
+int lirs_evict() {
+	int frame, slot;
+
+	if (queue->size[0] == 0) {
+		demote_bottom();
+	}
+	frame = ilist_tail(queue, 0);
+	ilist_remove(queue, frame);
+	present[frame] = 0;
+
+	if (stack->which[frame] != -1) {
+		// Still in S: it stays there as a non-resident HIR page
+		if (nonres->nfree == 0) {
+			slot = ilist_tail(nonres->l, 0);
+			ilist_remove(stack, memsize + slot);
+			ghost_remove(nonres, slot);
+		}
+		slot = ghost_add(nonres, 0, coremap[frame].pte);
+		ilist_replace(stack, frame, memsize + slot);
+	}
+	return frame;
+}
+
+/* This function is called on each access to a page to update any information
+ * needed by the LIRS algorithm.
+ * Input: The page table entry for the page that is being accessed.
+ */
+void lirs_ref(pgtbl_entry_t *p) {
+	int frame = p->frame >> PAGE_SHIFT;
+	int slot, was_bottom;
+
+	if (present[frame] && is_lir[frame]) {
+		was_bottom = ilist_tail(stack, 0) == frame;
+		stack_top(frame);
+		if (was_bottom) {
+			prune();
+		}
+		return;
+	}
+
+	if (present[frame]) {
+		// Resident HIR page
+		if (stack->which[frame] != -1) {
+			stack_top(frame);
+			ilist_remove(queue, frame);
+			is_lir[frame] = 1;
+			num_lir++;
+			demote_bottom();
+		} else {
+			stack_top(frame);
+			ilist_remove(queue, frame);
+			ilist_push(queue, 0, frame);
+		}
+		return;
+	}
+
+	// The page has just been loaded into this frame
+	present[frame] = 1;
+	slot = ghost_find(nonres, p);
+	if (slot != -1) {
+		ilist_remove(stack, memsize + slot);
+		ghost_remove(nonres, slot);
+	}
+	stack_top(frame);
+	if (num_lir < max_lir) {
+		// Until the LIR set is full, every new page joins it
+		is_lir[frame] = 1;
+		num_lir++;
+	} else if (slot != -1) {
+		// Reused while still in S: its reuse distance beats the bottom LIR
+		is_lir[frame] = 1;
+		num_lir++;
+		demote_bottom();
+	} else {
+		is_lir[frame] = 0;
+		ilist_push(queue, 0, frame);
+	}
+}
+
+/* Initialize any data structures needed for this
+ * replacement algorithm
+ */
+void lirs_init() {
+	int hir = memsize / 100 > 0 ? memsize / 100 : 1;
+
+	max_lir = memsize - hir;
+	stack = ilist_create(2 * memsize, 1);
+	queue = ilist_create(memsize, 1);
+	nonres = ghost_create(memsize, 1);
+	is_lir = calloc(memsize, sizeof(char));
+	present = calloc(memsize, sizeof(char));
+	if (is_lir == NULL || present == NULL) {
+		perror("Failed to allocate LIRS state");
+		exit(1);
+	}
+	num_lir = 0;
+}
@@ -1,43 +1,51 @@
-
-
-
 #include <stdio.h>
 #include <assert.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <stdlib.h>
 #include "pagetable.h"
+#include "checkpoint.h"
+#include "sim.h"
+
+/* The LRU list is a circular doubly-linked list of frame numbers, stored
+ * as two index arrays parallel to the coremap. Entry memsize is a sentinel
+ * whose next is the most recently used frame and whose prev is the least
+ * recently used one. A frame that is not on the list has next == -1.
+ * Everything is allocated once in lru_init, so references never malloc.
+ */
+static int *lru_next;
+static int *lru_prev;
+static int sentinel;
+
+static inline void lru_unlink(int frame) {
+	lru_next[lru_prev[frame]] = lru_next[frame];
+	lru_prev[lru_next[frame]] = lru_prev[frame];
+	lru_next[frame] = -1;
+}
 
-
-extern int memsize;
-
-extern int debug;
-
-extern struct frame *coremap;
-
-typedef struct _FRAME_LIST {
-	int frame;
-	struct _FRAME_LIST * next;
-	struct _FRAME_LIST * pre;
-} frame_list;
-
-
-frame_list* victim_list;
-frame_list** ptr_array;
 /* Page to evict is chosen using the accurate LRU algorithm.
  * Returns the page frame number (which is also the index in the coremap)
  * for the page that is to be evicted.
  */
-
 int lru_evict() {
-	int result;
-	frame_list* out = victim_list->pre;
-        out->pre->next = victim_list;
-        victim_list->pre = out->pre;
-        result = out->frame;
-        ptr_array[result] = NULL;
-        free(out);
-        
+	int result = lru_prev[sentinel];
+
+	assert(result != sentinel);
+	lru_unlink(result);
+	return result;
+}
+
+/* Evicts the least recently used page of process pid, which must have at
+ * least one page in memory.
+ */
+int lru_evict_local(int pid) {
+	int result = lru_prev[sentinel];
+
+	while (coremap[result].pid != pid) {
+		result = lru_prev[result];
+		assert(result != sentinel);
+	}
+	lru_unlink(result);
 	return result;
 }
 
@@ -47,84 +55,47 @@ int lru_evict() {
  */
 void lru_ref(pgtbl_entry_t *p) {
 	int fn = p->frame >> PAGE_SHIFT;
-	// no element in the list
-	// so we add p to it
-	if (victim_list == NULL) {
-                
-		victim_list = malloc(sizeof(victim_list));
-		victim_list->frame = fn;
-
-		victim_list->pre = victim_list;
-		victim_list->next = victim_list;
-		ptr_array[fn] = victim_list;
-	} else {
-		// if p is not in the array
-                // we allocate space for it and initialize its frame number
-		if (ptr_array[fn] == NULL) {
-			ptr_array[fn] = malloc(sizeof(frame_list));
-                        ptr_array[fn]->pre = NULL;
-                        ptr_array[fn]->next = NULL;
-		} 
-		frame_list* temp = ptr_array[fn];
-		temp->frame = fn;
-                
-                
-		// only one element in the list
-		// pre == itself
-		if (victim_list->next == victim_list && victim_list->pre == victim_list) {
-			temp->next = victim_list;
-			temp->pre = victim_list;
-			victim_list->pre = temp;
-			victim_list->next = temp;
-                        victim_list = temp;
-		} else {
-                        
-                        frame_list* tail = victim_list->pre;
-                        // if p is the tail
-                        // just change what victim_list points to
-                        if (tail->frame == fn) {
-                            victim_list = tail;
-                            return;
-                        }
-                        
-                        // if temp is newly added
-                        // it won't have a pre or a next
-                        // make it the head directly
-                        if (temp->pre == NULL) {
-                            temp->next = victim_list;
-                            temp->pre = tail;
-                            tail->next = temp;
-                            victim_list->pre = temp;
-                            victim_list = temp;
-
-                        // otherwise we change some pointers and move temp to the head
-                        } else {
-                            temp->pre->next = temp->next;
-                            temp->next->pre = temp->pre;
-                            temp->next = victim_list;
-                            temp->pre = tail;
-                            tail->next = temp;
-                            victim_list->pre = temp;
-                            victim_list = temp;
-                        
-                        }
 
-		}
+	if (lru_next[sentinel] == fn) {
+		return; // Already the most recently used
 	}
-	return;
+	if (lru_next[fn] != -1) {
+		lru_unlink(fn);
+	}
+	// Insert at the head, right after the sentinel
+	lru_next[fn] = lru_next[sentinel];
+	lru_prev[fn] = sentinel;
+	lru_prev[lru_next[sentinel]] = fn;
+	lru_next[sentinel] = fn;
 }
 
 
-/* Initialize any data structures needed for this 
- * replacement algorithm 
+/* Initialize any data structures needed for this
+ * replacement algorithm
  */
 void lru_init() {
-	victim_list = NULL;
-	ptr_array = malloc(sizeof(frame_list*) * memsize);
 	int i;
-	for (i = 0; i < memsize; i++) {
-		ptr_array[i] = NULL;
 
+	sentinel = memsize;
+	lru_next = malloc((memsize + 1) * sizeof(int));
+	lru_prev = malloc((memsize + 1) * sizeof(int));
+	if (lru_next == NULL || lru_prev == NULL) {
+		perror("Failed to allocate LRU list");
+		exit(1);
+	}
+	for (i = 0; i < memsize; i++) {
+		lru_next[i] = -1;
 	}
+	lru_next[sentinel] = sentinel;
+	lru_prev[sentinel] = sentinel;
 }
 
+void lru_save(FILE *fp) {
+	ckpt_write(fp, lru_next, (memsize + 1) * sizeof(int));
+	ckpt_write(fp, lru_prev, (memsize + 1) * sizeof(int));
+}
+
+void lru_load(FILE *fp) {
+	ckpt_read(fp, lru_next, (memsize + 1) * sizeof(int));
+	ckpt_read(fp, lru_prev, (memsize + 1) * sizeof(int));
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "pagemap.h"
+
+#define PAGEMAP_MIN_CAP 64
+
+static inline size_t pagemap_hash(struct pagemap *m, unsigned long key) {
+	// Fibonacci hashing spreads consecutive page numbers across the table
+	return (size_t)((key * 0x9E3779B97F4A7C15UL) >> m->shift);
+}
+
+static void pagemap_alloc(struct pagemap *m, size_t cap) {
+	size_t i;
+
+	m->cap = cap;
+	m->size = 0;
+	m->shift = 64;
+	while (cap > 1) {
+		m->shift--;
+		cap >>= 1;
+	}
+	m->keys = malloc(m->cap * sizeof(unsigned long));
+	m->vals = malloc(m->cap * sizeof(long));
+	if (m->keys == NULL || m->vals == NULL) {
+		perror("Failed to allocate page map");
+		exit(1);
+	}
+	for (i = 0; i < m->cap; i++) {
+		m->keys[i] = PAGEMAP_EMPTY;
+	}
+}
+
+/* Creates an empty map sized to hold about 'hint' keys without growing. */
+struct pagemap *pagemap_create(size_t hint) {
+	struct pagemap *m = malloc(sizeof(struct pagemap));
+	size_t cap = PAGEMAP_MIN_CAP;
+
+	if (m == NULL) {
+		perror("Failed to allocate page map");
+		exit(1);
+	}
+	while (cap < 2 * hint) {
+		cap *= 2;
+	}
+	pagemap_alloc(m, cap);
+	return m;
+}
+
+void pagemap_destroy(struct pagemap *m) {
+	free(m->keys);
+	free(m->vals);
+	free(m);
+}
+
+/* Returns a pointer to the value stored for key, or NULL if key is not in
+ * the map. The pointer is only valid until the next insert or remove.
+ */
+long *pagemap_lookup(struct pagemap *m, unsigned long key) {
+	size_t i = pagemap_hash(m, key);
+
+	assert(key != PAGEMAP_EMPTY);
+	while (m->keys[i] != PAGEMAP_EMPTY) {
+		if (m->keys[i] == key) {
+			return &m->vals[i];
+		}
+		i = (i + 1) & (m->cap - 1);
+	}
+	return NULL;
+}
+
+static void pagemap_grow(struct pagemap *m) {
+	unsigned long *oldkeys = m->keys;
+	long *oldvals = m->vals;
+	size_t oldcap = m->cap;
+	size_t i;
+
+	pagemap_alloc(m, oldcap * 2);
+	for (i = 0; i < oldcap; i++) {
+		if (oldkeys[i] != PAGEMAP_EMPTY) {
+			pagemap_insert(m, oldkeys[i], oldvals[i]);
+		}
+	}
+	free(oldkeys);
+	free(oldvals);
+}
+
+/* Sets the value for key, adding key if it is not already in the map.
+ * Returns a pointer to the stored value, valid until the next insert or
+ * remove.
+ */
+long *pagemap_insert(struct pagemap *m, unsigned long key, long val) {
+	size_t i;
+
+	assert(key != PAGEMAP_EMPTY);
+	if (2 * (m->size + 1) > m->cap) {
+		pagemap_grow(m);
+	}
+	i = pagemap_hash(m, key);
+	while (m->keys[i] != PAGEMAP_EMPTY && m->keys[i] != key) {
+		i = (i + 1) & (m->cap - 1);
+	}
+	if (m->keys[i] == PAGEMAP_EMPTY) {
+		m->keys[i] = key;
+		m->size++;
+	}
+	m->vals[i] = val;
+	return &m->vals[i];
+}
+
+/* Removes key from the map. Returns 0 if it was there, -1 if not.
+ * Later entries in the probe sequence are shifted back into the hole, so
+ * no tombstones are left behind to slow down future lookups.
+ */
+int pagemap_remove(struct pagemap *m, unsigned long key) {
+	size_t mask = m->cap - 1;
+	size_t i = pagemap_hash(m, key);
+	size_t j, home;
+
+	while (m->keys[i] != key) {
+		if (m->keys[i] == PAGEMAP_EMPTY) {
+			return -1;
+		}
+		i = (i + 1) & mask;
+	}
+	for (j = (i + 1) & mask; m->keys[j] != PAGEMAP_EMPTY; j = (j + 1) & mask) {
+		home = pagemap_hash(m, m->keys[j]);
+		// Move entry j into the hole at i unless its home slot lies
+		// cyclically in (i, j], in which case it is already reachable
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			m->keys[i] = m->keys[j];
+			m->vals[i] = m->vals[j];
+			i = j;
+		}
+	}
+	m->keys[i] = PAGEMAP_EMPTY;
+	m->size--;
+	return 0;
+}
+
+/* Removes every entry, keeping the current capacity. */
+void pagemap_clear(struct pagemap *m) {
+	size_t i;
+
+	for (i = 0; i < m->cap; i++) {
+		m->keys[i] = PAGEMAP_EMPTY;
+	}
+	m->size = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef __PAGEMAP_H__
+#define __PAGEMAP_H__
+
+#include <stddef.h>
+
+/* A hash map from a page key (a virtual page number, or a pointer that
+ * identifies a page such as its page table entry) to a long value.
+ * Uses open addressing with linear probing, and keeps the table at most
+ * half full, so lookups and inserts take expected constant time.
+ *
+ * The keys and vals arrays may be walked directly to visit every entry;
+ * slots whose key is PAGEMAP_EMPTY are unused.
+ */
+#define PAGEMAP_EMPTY   (~0UL)
+
+struct pagemap {
+	size_t cap;          // Number of slots, always a power of two
+	size_t size;         // Number of slots in use
+	int shift;           // 64 - log2(cap), for the multiplicative hash
+	unsigned long *keys;
+	long *vals;
+};
+
+extern struct pagemap *pagemap_create(size_t hint);
+extern void pagemap_destroy(struct pagemap *m);
+extern long *pagemap_lookup(struct pagemap *m, unsigned long key);
+extern long *pagemap_insert(struct pagemap *m, unsigned long key, long val);
+extern int pagemap_remove(struct pagemap *m, unsigned long key);
+extern void pagemap_clear(struct pagemap *m);
+
+#endif /* __PAGEMAP_H__ */
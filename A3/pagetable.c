@@ -2,59 +2,217 @@
 #include <string.h> 
 #include "sim.h"
 #include "pagetable.h"
+#include "stats.h"
+#include "tlb.h"
+#include "huge.h"
+#include "checkpoint.h"
+#include "prefetch.h"
+#include "cleaner.h"
 
 #define BIT_SET(a,b) ((a) |= (b))
 #define BIT_CLEAR(a,b) ((a) &= ~(b))
-// The top-level page table (also known as the 'page directory')
-pgdir_entry_t pgdir[PTRS_PER_PGDIR]; 
+
+// The processes seen in the trace so far, indexed by pid. Each has its
+// own top-level page table (also known as the 'page directory'), which
+// is the top level of the radix page table with -P radix.
+static struct process *processes[TRACE_MAX_PID + 1];
+struct process *curproc = NULL;
+int num_processes = 0;
+int pagetable_radix = 0;
+
+// With local replacement, a process that has its share of memory
+// replaces one of its own pages
+int replace_local = 0;
+
+// Memory used by page tables below the top level
+static unsigned long pt_tables = 0;
+static unsigned long pt_bytes = 0;
 
 // Counters for various events.
 // Your code must increment these when the related events occur.
-int hit_count = 0;
-int miss_count = 0;
-int ref_count = 0;
-int evict_clean_count = 0;
-int evict_dirty_count = 0;
+unsigned long hit_count = 0;
+unsigned long miss_count = 0;
+unsigned long ref_count = 0;
+unsigned long evict_clean_count = 0;
+unsigned long evict_dirty_count = 0;
+
+// The page being faulted in while evict_fcn runs. Policies that keep
+// history of evicted pages (like ARC) need to know it to pick a victim.
+pgtbl_entry_t *fault_pte = NULL;
+
+// Frames holding a page that must be written out before it is evicted
+int dirty_frames = 0;
+
+// Stack of free frame numbers, so that allocating or freeing a frame does
+// not have to scan the coremap. The lowest-numbered frame is on top
+// initially, which hands out frames in the same order as a coremap scan.
+static int *free_frames = NULL;
+static unsigned num_free = 0;
+
+/*
+ * Returns a frame that no longer holds any page to the free stack.
+ */
+void free_frame(int frame) {
+	assert(coremap[frame].in_use);
+	if (tlb_entries) {
+		tlb_invalidate_frame(frame);
+	}
+	coremap[frame].in_use = 0;
+	coremap[frame].pte = NULL;
+	free_frames[num_free++] = frame;
+}
+
+/*
+ * Marks the resident page p as modified since it was last written out.
+ */
+void mark_dirty(pgtbl_entry_t *p) {
+	if (!(p->frame & PG_DIRTY)) {
+		BIT_SET(p->frame, PG_DIRTY);
+		dirty_frames++;
+	}
+	if (p->frame & PG_CLEANED) {
+		// The copy the cleaner wrote out is already out of date
+		BIT_CLEAR(p->frame, PG_CLEANED);
+		cleaner_redirtied++;
+	}
+}
+
+/*
+ * Writes the dirty page p out to swap and marks it clean, leaving it in
+ * memory, for the page cleaner. Returns 0, or -1 if swap is full.
+ */
+int writeback_page(pgtbl_entry_t *p) {
+	off_t offset;
+
+	STATS_START(PHASE_SWAP);
+	offset = swap_pageout(p->frame >> PAGE_SHIFT, p->swap_off);
+	STATS_STOP(PHASE_SWAP);
+	if (offset == INVALID_SWAP) {
+		return -1;
+	}
+	p->swap_off = offset;
+	BIT_CLEAR(p->frame, PG_DIRTY);
+	BIT_SET(p->frame, PG_CLEANED);
+	dirty_frames--;
+	return 0;
+}
+
+/* Returns the number of frames that hold a page. */
+int frames_in_use() {
+	return memsize - num_free;
+}
+
+/*
+ * Picks the process that gives up a frame under local replacement. Memory
+ * is shared out equally between the processes seen so far: a process that
+ * has its share replaces one of its own pages, and one that has less takes
+ * a page from whichever process has the most.
+ */
+static int local_victim_pid() {
+	struct process *victim = curproc;
+	int i;
+
+	if (curproc->resident > 0 &&
+	    curproc->resident >= (int)memsize / num_processes) {
+		return curproc->pid;
+	}
+	for (i = 0; i <= TRACE_MAX_PID; i++) {
+		if (processes[i] != NULL &&
+		    processes[i]->resident > victim->resident) {
+			victim = processes[i];
+		}
+	}
+	return victim->pid;
+}
+
+/*
+ * Takes the page in frame out of memory. Writes it to swap if needed, and
+ * updates its pagetable entry to indicate that the virtual page is no
+ * longer in (simulated) physical memory. The frame itself stays allocated.
+ *
+ * Counters for evictions are updated here.
+ */
+static void evict_page(int frame) {
+	if (huge_threshold) {
+		// Only 4 KiB pages are evicted; a huge page is split first
+		huge_split(coremap[frame].pid, coremap[frame].vaddr);
+	}
+
+	struct frame victim_frame = coremap[frame];
+	pgtbl_entry_t *victim = victim_frame.pte;
+	struct process *owner = processes[victim_frame.pid];
+
+	owner->resident--;
+	if (victim->frame & PG_PREFETCH) {
+		prefetch_unused++;
+		BIT_CLEAR(victim->frame, PG_PREFETCH);
+	}
+	if (victim->frame & PG_DIRTY) {
+		// swap the page onto the disk only when the page has been modified
+		STATS_START(PHASE_SWAP);
+		off_t offset = swap_pageout(frame, victim->swap_off);
+		STATS_STOP(PHASE_SWAP);
+		victim->swap_off = offset;
+		evict_dirty_count += 1;
+		owner->evict_dirty_count++;
+		dirty_frames--;
+	} else {
+		evict_clean_count += 1;
+		owner->evict_clean_count++;
+		if (victim->frame & PG_CLEANED) {
+			// The write-back was done ahead of time by the cleaner
+			cleaner_saved++;
+			BIT_CLEAR(victim->frame, PG_CLEANED);
+		}
+	}
+	// set the onswap bit and the valid bit of the page
+	BIT_SET(victim->frame, PG_ONSWAP);
+	BIT_CLEAR(victim->frame, PG_VALID);
+	if (tlb_entries) {
+		tlb_invalidate_frame(frame);
+	}
+	if (on_evict_fcn != NULL) {
+		on_evict_fcn(frame, victim);
+	}
+}
+
+/*
+ * Evicts the page in frame and frees the frame, for replacement algorithms
+ * that shrink the resident set (like WS) rather than only replacing pages
+ * once memory is full. The algorithm must already have forgotten the frame,
+ * as it would for a frame returned by its evict function.
+ */
+void release_frame(int frame) {
+	evict_page(frame);
+	free_frame(frame);
+}
 
 /*
  * Allocates a frame to be used for the virtual page represented by p.
  * If all frames are in use, calls the replacement algorithm's evict_fcn to
- * select a victim frame.  Writes victim to swap if needed, and updates 
- * pagetable entry for victim to indicate that virtual page is no longer in
- * (simulated) physical memory.
- *
- * Counters for evictions should be updated appropriately in this function.
+ * select a victim frame, and evicts the page in it.
  */
 int allocate_frame(pgtbl_entry_t *p) {
-	int i;
 	int frame = -1;
-	for(i = 0; i < memsize; i++) {
-		if(!coremap[i].in_use) {
-			frame = i;
-			break;
-		}
-	}
-	if(frame == -1) { // Didn't find a free page.
+	if(num_free > 0) {
+		frame = free_frames[--num_free];
+		assert(!coremap[frame].in_use);
+	} else { // Didn't find a free page.
 		// Call replacement algorithm's evict function to select victim
-		frame = evict_fcn();
+		fault_pte = p;
+		STATS_START(PHASE_EVICT);
+		if (replace_local) {
+			frame = evict_local_fcn(local_victim_pid());
+		} else {
+			frame = evict_fcn();
+		}
+		STATS_STOP(PHASE_EVICT);
 
 		// All frames were in use, so victim frame must hold some page
-		// Write victim page to swap, if needed, and update pagetable
-		// IMPLEMENTATION NEEDED
-		struct frame victim_frame = coremap[frame];
-		pgtbl_entry_t *victim = victim_frame.pte;
-
-		if (victim->frame & PG_DIRTY) {
-			// swap the page onto the disk only when the page has been modified
-			off_t offset = swap_pageout(frame, victim->swap_off);
-			victim->swap_off = offset;
-			evict_dirty_count += 1;
-		} else {
-			evict_clean_count += 1;
+		if (coremap[frame].pid != curproc->pid) {
+			curproc->steal_count++;
 		}
-		// set the onswap bit and the valid bit of the page
-		BIT_SET(victim->frame, PG_ONSWAP);
-		BIT_CLEAR(victim->frame, PG_VALID);
+		evict_page(frame);
 	}
 
 	// Record information for virtual page that will now be stored in frame
@@ -65,26 +223,63 @@ int allocate_frame(pgtbl_entry_t *p) {
 }
 
 /*
- * Initializes the top-level pagetable.
+ * Initializes the page tables.
  * This function is called once at the start of the simulation.
- * For the simulation, there is a single "process" whose reference trace is 
- * being simulated, so there is just one top-level page table (page directory).
- * To keep things simple, we use a global array of 'page directory entries'.
- *
- * In a real OS, each process would have its own page directory, which would
- * need to be allocated and initialized as part of process creation.
+ * Each process in the trace has its own top-level page table (page
+ * directory), which is allocated when the process first appears, the way
+ * a real OS allocates one as part of process creation.
  */
 void init_pagetable() {
 	int i;
-	// Set all entries in top-level pagetable to 0, which ensures valid
-	// bits are all 0 initially.
-	for (i=0; i < PTRS_PER_PGDIR; i++) {
-		pgdir[i].pde = 0;
+
+	for (i = 0; i <= TRACE_MAX_PID; i++) {
+		processes[i] = NULL;
+	}
+	curproc = NULL;
+	num_processes = 0;
+
+	// Every frame in the coremap starts out free
+	free_frames = malloc(memsize * sizeof(int));
+	if (free_frames == NULL) {
+		perror("Failed to allocate free frame list");
+		exit(1);
+	}
+	for (num_free = 0; num_free < memsize; num_free++) {
+		free_frames[num_free] = memsize - 1 - num_free;
 	}
 }
 
-// For simulation, we get second-level pagetables from ordinary memory
-pgdir_entry_t init_second_level() {
+/*
+ * Makes pid the process whose references are being simulated, creating it
+ * with an empty page directory if it has not been seen before.
+ */
+void switch_process(int pid) {
+	struct process *proc;
+	int entries = pagetable_radix ? PTRS_PER_RADIX : PTRS_PER_PGDIR;
+
+	if (curproc != NULL && curproc->pid == pid) {
+		return;
+	}
+	if (processes[pid] == NULL) {
+		proc = calloc(1, sizeof(struct process));
+		// All entries start as 0, so their valid bits are clear
+		if (proc == NULL ||
+		    (proc->pgdir = calloc(entries, sizeof(pgdir_entry_t))) == NULL) {
+			perror("Failed to allocate process");
+			exit(1);
+		}
+		proc->pid = pid;
+		processes[pid] = proc;
+		num_processes++;
+	}
+	curproc = processes[pid];
+}
+
+// For simulation, we get second-level pagetables from ordinary memory.
+// A table of 'entries' page table entries is allocated, which is
+// PTRS_PER_PGTBL for the two-level page table and PTRS_PER_RADIX for the
+// bottom level of the radix one.
+pgdir_entry_t init_second_level(int entries) {
 	int i;
 	pgdir_entry_t new_entry;
 	pgtbl_entry_t *pgtbl;
@@ -92,13 +287,15 @@ pgdir_entry_t init_second_level() {
 	// Allocating aligned memory ensures the low bits in the pointer must
 	// be zero, so we can use them to store our status bits, like PG_VALID
 	if (posix_memalign((void **)&pgtbl, PAGE_SIZE, 
-			   PTRS_PER_PGTBL*sizeof(pgtbl_entry_t)) != 0) {
+			   entries*sizeof(pgtbl_entry_t)) != 0) {
 		perror("Failed to allocate aligned memory for page table");
 		exit(1);
 	}
+	pt_tables++;
+	pt_bytes += entries*sizeof(pgtbl_entry_t);
 
 	// Initialize all entries in second-level pagetable
-	for (i=0; i < PTRS_PER_PGTBL; i++) {
+	for (i=0; i < entries; i++) {
 		pgtbl[i].frame = 0; // sets all bits, including valid, to zero
 		pgtbl[i].swap_off = INVALID_SWAP;
 	}
@@ -109,6 +306,24 @@ pgdir_entry_t init_second_level() {
 	return new_entry;
 }
 
+// Allocates an empty intermediate level of the radix page table.
+pgdir_entry_t init_radix_level() {
+	pgdir_entry_t new_entry;
+	pgdir_entry_t *dir;
+
+	if (posix_memalign((void **)&dir, PAGE_SIZE,
+			   PTRS_PER_RADIX*sizeof(pgdir_entry_t)) != 0) {
+		perror("Failed to allocate aligned memory for page table");
+		exit(1);
+	}
+	pt_tables++;
+	pt_bytes += PTRS_PER_RADIX*sizeof(pgdir_entry_t);
+	memset(dir, 0, PTRS_PER_RADIX*sizeof(pgdir_entry_t));
+
+	new_entry.pde = (uintptr_t)dir | PG_VALID;
+	return new_entry;
+}
+
 /* 
  * Initializes the content of a (simulated) physical memory frame when it 
  * is first allocated for some virtual address.  Just like in a real OS,
@@ -131,6 +346,102 @@ void init_frame(int frame, addr_t vaddr) {
 	return;
 }
 
+/*
+ * Brings the page with pte p and virtual address vaddr into a frame, from
+ * swap if it has been there, or as a new zero-filled page otherwise.
+ */
+void page_in(pgtbl_entry_t *p, addr_t vaddr) {
+	int frame = allocate_frame(p);
+
+	if (p->frame & PG_ONSWAP) {
+		// if the page is on swap
+		p->frame = (unsigned long)frame << PAGE_SHIFT;
+		STATS_START(PHASE_SWAP);
+		swap_pagein(frame, p->swap_off);
+		STATS_STOP(PHASE_SWAP);
+	} else {
+		// if the page is not on swap
+		p->frame = (unsigned long)frame << PAGE_SHIFT;
+		p->swap_off = INVALID_SWAP;
+		init_frame(frame, vaddr);
+		mark_dirty(p);
+	}
+	BIT_SET(p->frame, PG_VALID);
+	coremap[frame].vaddr = vaddr;
+	coremap[frame].pid = curproc->pid;
+	curproc->resident++;
+}
+
+/* Returns the page table entry for vaddr in the two-level page table,
+ * allocating the second-level table that holds it if needed.
+ */
+static pgtbl_entry_t *lookup_pte_2level(addr_t vaddr) {
+	unsigned long idx = PGDIR_INDEX(vaddr); // get index into page directory
+	pgdir_entry_t *page_table;
+	pgtbl_entry_t *second_level;
+
+	if (idx >= PTRS_PER_PGDIR) {
+		fprintf(stderr, "Error: address %lx is too large for the "
+			"two-level page table; try -P radix\n", vaddr);
+		exit(1);
+	}
+
+	// Use top-level page directory to get pointer to 2nd-level page table
+	page_table = &curproc->pgdir[idx];
+
+	// Use vaddr to get index into 2nd-level page table and initialize 'p'
+	if (page_table->pde == 0) {
+		*page_table = init_second_level(PTRS_PER_PGTBL);
+	}
+	// get the pointer to the second level of page table
+	second_level = (pgtbl_entry_t *)(page_table->pde & PAGE_MASK);
+	return &second_level[PGTBL_INDEX(vaddr)];
+}
+
+/* Returns the page table entry for vaddr in the radix page table,
+ * allocating any levels on the way down to it that do not exist yet.
+ */
+static pgtbl_entry_t *lookup_pte_radix(addr_t vaddr) {
+	pgdir_entry_t *dir = curproc->pgdir;
+	pgdir_entry_t *entry;
+	int level;
+
+	if (vaddr >> RADIX_VADDR_BITS) {
+		fprintf(stderr, "Error: address %lx is wider than %d bits\n",
+			vaddr, RADIX_VADDR_BITS);
+		exit(1);
+	}
+	for (level = RADIX_LEVELS - 1; level > 1; level--) {
+		entry = &dir[RADIX_INDEX(vaddr, level)];
+		if (entry->pde == 0) {
+			*entry = init_radix_level();
+		}
+		dir = (pgdir_entry_t *)(entry->pde & PAGE_MASK);
+	}
+	entry = &dir[RADIX_INDEX(vaddr, 1)];
+	if (entry->pde == 0) {
+		*entry = init_second_level(PTRS_PER_RADIX);
+	}
+	return &((pgtbl_entry_t *)(entry->pde & PAGE_MASK))[RADIX_INDEX(vaddr, 0)];
+}
+
+/* Sets or clears PG_HUGE in the radix level 1 entry covering vaddr in the
+ * address space of process pid, which must already exist.
+ */
+void set_pmd_huge(int pid, addr_t vaddr, int huge) {
+	pgdir_entry_t *dir = processes[pid]->pgdir;
+	int level;
+
+	for (level = RADIX_LEVELS - 1; level > 1; level--) {
+		dir = (pgdir_entry_t *)(dir[RADIX_INDEX(vaddr, level)].pde & PAGE_MASK);
+	}
+	if (huge) {
+		BIT_SET(dir[RADIX_INDEX(vaddr, 1)].pde, PG_HUGE);
+	} else {
+		BIT_CLEAR(dir[RADIX_INDEX(vaddr, 1)].pde, PG_HUGE);
+	}
+}
+
 /*
  * Locate the physical frame number for the given vaddr using the page table.
  *
@@ -146,42 +457,69 @@ void init_frame(int frame, addr_t vaddr) {
  */
 char *find_physpage(addr_t vaddr, char type) {
 	pgtbl_entry_t *p=NULL; // pointer to the full page table entry for vaddr
-	unsigned idx = PGDIR_INDEX(vaddr); // get index into page directory
 
-	// IMPLEMENTATION NEEDED
-	// Use top-level page directory to get pointer to 2nd-level page table
-	pgdir_entry_t *page_table = &pgdir[idx];
+	int tlb_miss = 0;
 
-	// Use vaddr to get index into 2nd-level page table and initialize 'p'
-	if (page_table->pde == 0) {
-		*page_table = init_second_level();
+	// Read-ahead asked for by the last reference arrives first
+	if (prefetcher != NULL) {
+		prefetch_pending();
 	}
-	// get the pointer to the second level of page table
-	pgtbl_entry_t *second_level = (pgtbl_entry_t *) ((page_table->pde >> PAGE_SHIFT) << PAGE_SHIFT);
-	p = &second_level[PGTBL_INDEX(vaddr)];
+	// A TLB hit gives the pte of a resident page without a walk
+	if (tlb_entries) {
+		p = tlb_lookup(vaddr);
+		tlb_miss = p == NULL;
+	}
+	// Otherwise walk the page table for vaddr, filling in missing levels
+	if (p == NULL) {
+		STATS_START(PHASE_WALK);
+		if (pagetable_radix) {
+			p = lookup_pte_radix(vaddr);
+		} else {
+			p = lookup_pte_2level(vaddr);
+		}
+		STATS_STOP(PHASE_WALK);
+	}
+
 	// Check if p is valid or not, on swap or not, and handle appropriately
 	if (p->frame & PG_VALID) {
 		hit_count++;
+		curproc->hit_count++;
+		if (p->frame & PG_PREFETCH) {
+			prefetch_use(vaddr, p);
+		}
 	} else {
 		miss_count++;
-		if (p->frame & PG_ONSWAP) {
-			// if the page is on swap
-			p->frame = allocate_frame(p) << PAGE_SHIFT;
-			swap_pagein(p->frame >> PAGE_SHIFT, p->swap_off);
-		} else {
-			// if the page is not on swap
-			p->frame = allocate_frame(p) << PAGE_SHIFT;
-			p->swap_off = INVALID_SWAP;
-			init_frame(p->frame >> PAGE_SHIFT, vaddr);
-			BIT_SET(p->frame, PG_DIRTY);
+		curproc->miss_count++;
+		if (on_fault_fcn != NULL) {
+			on_fault_fcn(p);
+		}
+		// Pages read around the fault come in ahead of this one, so that
+		// they cannot push it out
+		if (prefetcher != NULL) {
+			prefetch_fault(vaddr);
 		}
-		BIT_SET(p->frame, PG_VALID);
+		// The fault may be the one that makes its region a huge page
+		if (!huge_threshold || !huge_fault(vaddr, p)) {
+			page_in(p, vaddr);
+		}
+	}
+	if (huge_threshold) {
+		huge_ref(vaddr, type);
 	}
 	if (type == 'M' || type == 'S') {
-		BIT_SET(p->frame, PG_DIRTY);
+		mark_dirty(p);
+		// The copy in swap is now out of date, and the page will need
+		// writing out again anyway, so its slot can be reused
+		if (p->swap_off != INVALID_SWAP) {
+			swap_free(p->swap_off);
+			p->swap_off = INVALID_SWAP;
+		}
 	}
 	ref_count++;
 	BIT_SET(p->frame, PG_REF);
+	if (tlb_miss) {
+		tlb_insert(vaddr, p);
+	}
 
 	// Make sure that p is marked valid and referenced. Also mark it
 	// dirty if the access type indicates that the page will be written to.
@@ -191,16 +529,21 @@ char *find_physpage(addr_t vaddr, char type) {
 	// Call replacement algorithm's ref_fcn for this page
 	ref_fcn(p);
 
+	// Too few frames could be reused without a write: wake the cleaner
+	if (cleaner_low && (int)memsize - dirty_frames < cleaner_low) {
+		cleaner_run();
+	}
+
 	// Return pointer into (simulated) physical memory at start of frame
 	return  &physmem[(p->frame >> PAGE_SHIFT)*SIMPAGESIZE];
 }
 
-void print_pagetbl(pgtbl_entry_t *pgtbl) {
+void print_pagetbl(pgtbl_entry_t *pgtbl, int entries) {
 	int i;
 	int first_invalid, last_invalid;
 	first_invalid = last_invalid = -1;
 
-	for (i=0; i < PTRS_PER_PGTBL; i++) {
+	for (i=0; i < entries; i++) {
 		if (!(pgtbl[i].frame & PG_VALID) && 
 		    !(pgtbl[i].frame & PG_ONSWAP)) {
 			if (first_invalid == -1) {
@@ -219,7 +562,7 @@ void print_pagetbl(pgtbl_entry_t *pgtbl) {
 				if (pgtbl[i].frame & PG_DIRTY) {
 					printf("DIRTY, ");
 				}
-				printf("in frame %d\n",pgtbl[i].frame >> PAGE_SHIFT);
+				printf("in frame %lu\n",pgtbl[i].frame >> PAGE_SHIFT);
 			} else {
 				assert(pgtbl[i].frame & PG_ONSWAP);
 				printf("ONSWAP, at offset %lu\n",pgtbl[i].swap_off);
@@ -232,13 +575,54 @@ void print_pagetbl(pgtbl_entry_t *pgtbl) {
 	}
 }
 
-void print_pagedirectory() {
+/* Prints one level of the radix page table in the same form as the
+ * two-level page directory, indenting each level below the top by a tab.
+ */
+static void print_radix_level(pgdir_entry_t *dir, int level) {
+	int i;
+	int first_invalid, last_invalid;
+	int indent = RADIX_LEVELS - 1 - level;
+	first_invalid = last_invalid = -1;
+
+	for (i=0; i < PTRS_PER_RADIX; i++) {
+		if (!(dir[i].pde & PG_VALID)) {
+			if (first_invalid == -1) {
+				first_invalid = i;
+			}
+			last_invalid = i;
+			continue;
+		}
+		if (first_invalid != -1) {
+			printf("%*s[%d]: INVALID\n%*s  to\n%*s[%d]: INVALID\n",
+			       indent, "", first_invalid, indent, "",
+			       indent, "", last_invalid);
+			first_invalid = last_invalid = -1;
+		}
+		printf("%*s[%d]: %p%s\n", indent, "", i,
+		       (void *)(dir[i].pde & PAGE_MASK),
+		       (dir[i].pde & PG_HUGE) ? " HUGE" : "");
+		if (level == 1) {
+			print_pagetbl((pgtbl_entry_t *)(dir[i].pde & PAGE_MASK),
+				      PTRS_PER_RADIX);
+		} else {
+			print_radix_level((pgdir_entry_t *)(dir[i].pde & PAGE_MASK),
+					  level - 1);
+		}
+	}
+}
+
+static void print_pgdir(pgdir_entry_t *pgdir) {
 	int i; // index into pgdir
 	int first_invalid,last_invalid;
 	first_invalid = last_invalid = -1;
 
 	pgtbl_entry_t *pgtbl;
 
+	if (pagetable_radix) {
+		print_radix_level(pgdir, RADIX_LEVELS - 1);
+		return;
+	}
+
 	for (i=0; i < PTRS_PER_PGDIR; i++) {
 		if (!(pgdir[i].pde & PG_VALID)) {
 			if (first_invalid == -1) {
@@ -253,7 +637,228 @@ void print_pagedirectory() {
 			}
 			pgtbl = (pgtbl_entry_t *)(pgdir[i].pde & PAGE_MASK);
 			printf("[%d]: %p\n",i, pgtbl);
-			print_pagetbl(pgtbl);
+			print_pagetbl(pgtbl, PTRS_PER_PGTBL);
+		}
+	}
+}
+
+/* Prints the page directory of every process, under a heading for each
+ * one if there is more than one.
+ */
+void print_pagedirectory() {
+	int i;
+
+	for (i = 0; i <= TRACE_MAX_PID; i++) {
+		if (processes[i] != NULL) {
+			if (num_processes > 1) {
+				printf("Process %d:\n", i);
+			}
+			print_pgdir(processes[i]->pgdir);
+		}
+	}
+}
+
+/* Prints how much memory the radix page tables took, including the top
+ * level. Nothing is printed for the default 2-level layout, so that its
+ * output stays as it was.
+ */
+void pagetable_report() {
+	unsigned long top = num_processes * sizeof(pgdir_entry_t) *
+		PTRS_PER_RADIX;
+
+	if (!pagetable_radix) {
+		return;
+	}
+	printf("Page table memory: %lu bytes in %lu table%s below the top level"
+	       " (%lu bytes at the top)\n", pt_bytes, pt_tables,
+	       pt_tables == 1 ? "" : "s", top);
+}
+
+/* Prints the counters of each process, if the trace had more than one. */
+void process_report() {
+	struct process *proc;
+	int i;
+
+	if (num_processes < 2) {
+		return;
+	}
+	printf("Processes: %d, %s replacement\n", num_processes,
+	       replace_local ? "local" : "global");
+	for (i = 0; i <= TRACE_MAX_PID; i++) {
+		if ((proc = processes[i]) == NULL) {
+			continue;
+		}
+		printf("Process %d: %lu hits, %lu misses, hit rate %.4f, "
+		       "%lu clean and %lu dirty evictions, %d pages taken from "
+		       "others, %d frames at exit\n", proc->pid, proc->hit_count,
+		       proc->miss_count, (double)proc->hit_count /
+		       (proc->hit_count + proc->miss_count) * 100,
+		       proc->evict_clean_count, proc->evict_dirty_count,
+		       proc->steal_count, proc->resident);
+	}
+}
+
+/* Writes the page table entries below radix directory dir (at the given
+ * level, covering addresses from base) that have ever held a page.
+ */
+static void save_radix_ptes(FILE *fp, pgdir_entry_t *dir, int level,
+			    addr_t base) {
+	pgtbl_entry_t *pgtbl;
+	addr_t vaddr;
+	int i, j;
+
+	for (i = 0; i < PTRS_PER_RADIX; i++) {
+		if (!(dir[i].pde & PG_VALID)) {
+			continue;
+		}
+		vaddr = base | ((addr_t)i << (PAGE_SHIFT + level*RADIX_BITS));
+		if (level > 1) {
+			save_radix_ptes(fp, (pgdir_entry_t *)(dir[i].pde & PAGE_MASK),
+					level - 1, vaddr);
+			continue;
+		}
+		pgtbl = (pgtbl_entry_t *)(dir[i].pde & PAGE_MASK);
+		for (j = 0; j < PTRS_PER_RADIX; j++) {
+			if (pgtbl[j].frame != 0) {
+				addr_t v = vaddr | ((addr_t)j << PAGE_SHIFT);
+
+				ckpt_write(fp, &v, sizeof(v));
+				ckpt_write(fp, &pgtbl[j], sizeof(pgtbl_entry_t));
+			}
+		}
+	}
+}
+
+/* Writes the page table entries of a process that have ever held a page,
+ * each with its virtual address, ending with an address of ~0.
+ */
+static void save_ptes(FILE *fp, pgdir_entry_t *pgdir) {
+	pgtbl_entry_t *pgtbl;
+	addr_t end = ~0UL;
+	int i, j;
+
+	if (pagetable_radix) {
+		save_radix_ptes(fp, pgdir, RADIX_LEVELS - 1, 0);
+	} else {
+		for (i = 0; i < PTRS_PER_PGDIR; i++) {
+			if (!(pgdir[i].pde & PG_VALID)) {
+				continue;
+			}
+			pgtbl = (pgtbl_entry_t *)(pgdir[i].pde & PAGE_MASK);
+			for (j = 0; j < PTRS_PER_PGTBL; j++) {
+				if (pgtbl[j].frame != 0) {
+					addr_t v = ((addr_t)i << PGDIR_SHIFT) |
+						((addr_t)j << PAGE_SHIFT);
+
+					ckpt_write(fp, &v, sizeof(v));
+					ckpt_write(fp, &pgtbl[j], sizeof(pgtbl_entry_t));
+				}
+			}
 		}
 	}
+	ckpt_write(fp, &end, sizeof(end));
+}
+
+/* Returns the page table entry for vaddr in the current process,
+ * allocating the tables that hold it if needed.
+ */
+pgtbl_entry_t *lookup_pte(addr_t vaddr) {
+	return pagetable_radix ? lookup_pte_radix(vaddr) : lookup_pte_2level(vaddr);
+}
+
+/*
+ * Writes the state of memory to a checkpoint: the counters, every process
+ * and its page tables, the coremap, the free frames and physical memory.
+ * Pointers are not saved; page table entries are saved by virtual address
+ * and the coremap's pte pointers are found again from them by
+ * pagetable_load.
+ */
+void pagetable_save(FILE *fp) {
+	int i, none = -1;
+
+	ckpt_write(fp, &hit_count, sizeof(hit_count));
+	ckpt_write(fp, &miss_count, sizeof(miss_count));
+	ckpt_write(fp, &ref_count, sizeof(ref_count));
+	ckpt_write(fp, &evict_clean_count, sizeof(evict_clean_count));
+	ckpt_write(fp, &evict_dirty_count, sizeof(evict_dirty_count));
+	ckpt_write(fp, &pt_tables, sizeof(pt_tables));
+	ckpt_write(fp, &pt_bytes, sizeof(pt_bytes));
+
+	for (i = 0; i <= TRACE_MAX_PID; i++) {
+		if (processes[i] != NULL) {
+			ckpt_write(fp, &i, sizeof(i));
+			ckpt_write(fp, processes[i], sizeof(struct process));
+			save_ptes(fp, processes[i]->pgdir);
+		}
+	}
+	ckpt_write(fp, &none, sizeof(none));
+	ckpt_write(fp, curproc != NULL ? &curproc->pid : &none, sizeof(int));
+
+	for (i = 0; i < memsize; i++) {
+		ckpt_write(fp, &coremap[i].in_use, sizeof(char));
+		ckpt_write(fp, &coremap[i].vaddr, sizeof(addr_t));
+		ckpt_write(fp, &coremap[i].pid, sizeof(int));
+	}
+	ckpt_write(fp, &num_free, sizeof(num_free));
+	ckpt_write(fp, free_frames, num_free * sizeof(int));
+	ckpt_write(fp, physmem, (size_t)memsize * SIMPAGESIZE);
+}
+
+/*
+ * Restores what pagetable_save wrote, into the empty page tables and
+ * coremap set up by init_simulation for the same memsize and layout.
+ */
+void pagetable_load(FILE *fp) {
+	struct process saved;
+	unsigned long tables, bytes;
+	pgtbl_entry_t pte;
+	addr_t vaddr;
+	int i, pid;
+
+	ckpt_read(fp, &hit_count, sizeof(hit_count));
+	ckpt_read(fp, &miss_count, sizeof(miss_count));
+	ckpt_read(fp, &ref_count, sizeof(ref_count));
+	ckpt_read(fp, &evict_clean_count, sizeof(evict_clean_count));
+	ckpt_read(fp, &evict_dirty_count, sizeof(evict_dirty_count));
+	ckpt_read(fp, &tables, sizeof(tables));
+	ckpt_read(fp, &bytes, sizeof(bytes));
+
+	while (ckpt_read(fp, &pid, sizeof(pid)), pid != -1) {
+		if (pid < 0 || pid > TRACE_MAX_PID) {
+			fprintf(stderr, "Error: bad process %d in checkpoint\n", pid);
+			exit(1);
+		}
+		ckpt_read(fp, &saved, sizeof(saved));
+		switch_process(pid);
+		saved.pid = pid;
+		saved.pgdir = curproc->pgdir;
+		*curproc = saved;
+		while (ckpt_read(fp, &vaddr, sizeof(vaddr)), vaddr != ~0UL) {
+			ckpt_read(fp, &pte, sizeof(pte));
+			*lookup_pte(vaddr) = pte;
+		}
+	}
+	// The walks above allocated the same tables again
+	pt_tables = tables;
+	pt_bytes = bytes;
+
+	ckpt_read(fp, &pid, sizeof(pid));
+	for (i = 0; i < memsize; i++) {
+		ckpt_read(fp, &coremap[i].in_use, sizeof(char));
+		ckpt_read(fp, &coremap[i].vaddr, sizeof(addr_t));
+		ckpt_read(fp, &coremap[i].pid, sizeof(int));
+		coremap[i].pte = NULL;
+		if (coremap[i].in_use) {
+			switch_process(coremap[i].pid);
+			coremap[i].pte = lookup_pte(coremap[i].vaddr);
+		}
+	}
+	curproc = pid == -1 ? NULL : processes[pid];
+	ckpt_read(fp, &num_free, sizeof(num_free));
+	if (num_free > memsize) {
+		fprintf(stderr, "Error: bad free frame count in checkpoint\n");
+		exit(1);
+	}
+	ckpt_read(fp, free_frames, num_free * sizeof(int));
+	ckpt_read(fp, physmem, (size_t)memsize * SIMPAGESIZE);
 }
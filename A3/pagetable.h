@@ -14,6 +14,9 @@
 #define PG_DIRTY        (0x2) // Dirty bit in pgd or pte, set if modified
 #define PG_REF          (0x4) // Reference bit, set if page has been referenced
 #define PG_ONSWAP       (0x8) // Set if page has been evicted to swap
+#define PG_HUGE         (0x10) // In a radix level 1 entry: maps a huge page
+#define PG_PREFETCH     (0x20) // Prefetched, and not referenced since
+#define PG_CLEANED      (0x40) // Written out by the cleaner, not modified since
 #define INVALID_SWAP    -1
 
 #ifdef TRACE_64
@@ -40,6 +43,18 @@
 #define PGDIR_INDEX(x)   ((x) >> PGDIR_SHIFT)
 #define PGTBL_INDEX(x)   (((x) >> PAGE_SHIFT) & PGTBL_MASK)
 
+// With -P radix, addresses of up to 48 bits are translated instead by a
+// four-level radix tree like the x86-64 one. Each level takes 9 bits of
+// the page number and has 512 entries, and tables below the top level are
+// only allocated once an address in their range is used. Level 0 holds
+// the page table entries and level 3 is the top.
+#define RADIX_LEVELS       4
+#define RADIX_BITS         9
+#define PTRS_PER_RADIX     (1 << RADIX_BITS)
+#define RADIX_VADDR_BITS   (PAGE_SHIFT + RADIX_LEVELS*RADIX_BITS)
+#define RADIX_INDEX(x, level) \
+	(((x) >> (PAGE_SHIFT + (level)*RADIX_BITS)) & (PTRS_PER_RADIX-1))
+
 
 typedef unsigned long addr_t;
 
@@ -52,19 +67,56 @@ typedef struct {
 
 // Page table entry (2nd-level). 
 typedef struct { 
-	unsigned int frame; // if valid bit == 1, physical frame holding vpage
+	unsigned long frame; // if valid bit == 1, physical frame holding vpage
 	off_t swap_off;       // offset in swap file of vpage, if any
 } pgtbl_entry_t;    
 
+extern int pagetable_radix;    // Use the four-level radix page table
+
+/* A process in the trace. Each one has its own top-level page table, and
+ * all of them share the coremap.
+ */
+struct process {
+	int pid;
+	pgdir_entry_t *pgdir;  // Top level: PTRS_PER_PGDIR entries, or
+	                       // PTRS_PER_RADIX with -P radix
+	int resident;          // Frames holding its pages
+	unsigned long hit_count;
+	unsigned long miss_count;
+	unsigned long evict_clean_count; // Its pages that were evicted
+	unsigned long evict_dirty_count;
+	int steal_count;       // Its faults that evicted another's page
+};
+
+extern struct process *curproc; // Process whose reference is simulated
+extern int num_processes;
+extern int replace_local;      // Victims come from the faulting process
+
 extern void init_pagetable();
+extern void switch_process(int pid);
+extern void process_report(void);
 extern char *find_physpage(addr_t vaddr, char type);
+extern void free_frame(int frame);
+extern void release_frame(int frame);
+extern int frames_in_use(void);
+extern void page_in(pgtbl_entry_t *p, addr_t vaddr);
+extern void set_pmd_huge(int pid, addr_t vaddr, int huge);
+extern pgtbl_entry_t *lookup_pte(addr_t vaddr);
+extern void mark_dirty(pgtbl_entry_t *p);
+extern int writeback_page(pgtbl_entry_t *p);
+extern int dirty_frames;
 
 extern void print_pagedirectory(void);
+extern void pagetable_report(void);
+extern void pagetable_save(FILE *fp);
+extern void pagetable_load(FILE *fp);
 
 struct frame {
 	char in_use;       // True if frame is allocated, False if frame is free
 	pgtbl_entry_t *pte;// Pointer back to pagetable entry (pte) for page
 	                   // stored in this frame
+	addr_t vaddr;      // Virtual address the page was faulted in at
+	int pid;           // Process the page belongs to
 };
 
 /* The coremap holds information about physical memory.
@@ -73,18 +125,36 @@ struct frame {
  */
 extern struct frame *coremap;
 
+// Page table entry of the page being faulted in, while evict_fcn runs
+extern pgtbl_entry_t *fault_pte;
+
 
 // Swap functions for use in other files
 extern int swap_init(unsigned swapsize);
 extern void swap_destroy(void);
 extern int swap_pagein(unsigned frame, int swap_offset);
 extern int swap_pageout(unsigned frame, int swap_offset);
+extern void swap_free(int swap_offset);
+extern int swap_select(const char *name);
+extern void swap_report(void);
+extern unsigned swap_slots_in_use(void);
+extern unsigned swap_slots_total(void);
+extern char *swap_snapshot(void);
+extern void swap_save(FILE *fp, const char *snap);
+extern void swap_load(FILE *fp);
 
 extern void rand_init();
 extern void lru_init();
 extern void clock_init();
 extern void fifo_init();
 extern void opt_init();
+extern void wopt_init();
+extern void arc_init();
+extern void twoq_init();
+extern void lirs_init();
+extern void clockpro_init();
+extern void ws_init();
+extern void pff_init();
 
 // These may not need to do anything for some algorithms
 extern void rand_ref(pgtbl_entry_t *);
@@ -92,11 +162,45 @@ extern void lru_ref(pgtbl_entry_t *);
 extern void clock_ref(pgtbl_entry_t *);
 extern void fifo_ref(pgtbl_entry_t *);
 extern void opt_ref(pgtbl_entry_t *);
+extern void wopt_ref(pgtbl_entry_t *);
+extern void arc_ref(pgtbl_entry_t *);
+extern void twoq_ref(pgtbl_entry_t *);
+extern void lirs_ref(pgtbl_entry_t *);
+extern void clockpro_ref(pgtbl_entry_t *);
+extern void ws_ref(pgtbl_entry_t *);
 
 extern int rand_evict();
 extern int lru_evict();
 extern int clock_evict();
 extern int fifo_evict();
 extern int opt_evict();
+extern int wopt_evict();
+extern int arc_evict();
+extern int twoq_evict();
+extern int lirs_evict();
+extern int clockpro_evict();
+extern int ws_evict();
+
+extern int rand_evict_local(int pid);
+extern int lru_evict_local(int pid);
+extern int clock_evict_local(int pid);
+extern int fifo_evict_local(int pid);
+extern int ws_evict_local(int pid);
+
+extern void rand_save(FILE *fp);
+extern void lru_save(FILE *fp);
+extern void clock_save(FILE *fp);
+extern void fifo_save(FILE *fp);
+extern void rand_load(FILE *fp);
+extern void lru_load(FILE *fp);
+extern void clock_load(FILE *fp);
+extern void fifo_load(FILE *fp);
+
+extern void opt_fill(pgtbl_entry_t *);
+extern void wopt_fill(pgtbl_entry_t *);
+extern void ws_fill(pgtbl_entry_t *);
+
+extern void wopt_report();
+extern void ws_report();
 
 #endif /* PAGETABLE_H */
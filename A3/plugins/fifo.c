@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "pagetable.h"
+#include "checkpoint.h"
+
+/* FIFO as a loadable policy, as an example for sim -a ./plugins/fifo.so.
+ *
+ * Frames are queued in the order pages were loaded into them. The on_fault
+ * hook notes which page is arriving, so that ref can tell a newly loaded
+ * page from a hit, and on_evict counts evictions for the report. Pages
+ * loaded without a fault, such as the rest of a huge page, come to fill.
+ * evict_local lets the policy be used with --scope local, and save and
+ * load with --checkpoint-every.
+ */
+
+extern unsigned memsize;
+
+static int *queue;            // Frames in load order, as a ring
+static int head, count;
+static pgtbl_entry_t *arriving;
+static int faults, evictions;
+
+void on_fault(pgtbl_entry_t *p) {
+	arriving = p;
+	faults++;
+}
+
+void on_evict(int frame, pgtbl_entry_t *victim) {
+	evictions++;
+}
+
+int evict() {
+	int frame = queue[head];
+
+	head = (head + 1) % memsize;
+	count--;
+	return frame;
+}
+
+/* The oldest page of process pid leaves the queue. */
+int evict_local(int pid) {
+	int i, frame;
+
+	for (i = 0; coremap[queue[(head + i) % memsize]].pid != pid; i++) {
+	}
+	frame = queue[(head + i) % memsize];
+	// Close the gap by moving the older frames along by one
+	for (; i > 0; i--) {
+		queue[(head + i) % memsize] = queue[(head + i - 1) % memsize];
+	}
+	head = (head + 1) % memsize;
+	count--;
+	return frame;
+}
+
+void ref(pgtbl_entry_t *p) {
+	if (p == arriving) {
+		queue[(head + count) % memsize] = p->frame >> PAGE_SHIFT;
+		count++;
+		arriving = NULL;
+	}
+}
+
+/* Pages brought in without a reference join the queue too. */
+void fill(pgtbl_entry_t *p) {
+	queue[(head + count) % memsize] = p->frame >> PAGE_SHIFT;
+	count++;
+}
+
+void save(FILE *fp) {
+	ckpt_write(fp, &head, sizeof(head));
+	ckpt_write(fp, &count, sizeof(count));
+	ckpt_write(fp, &faults, sizeof(faults));
+	ckpt_write(fp, &evictions, sizeof(evictions));
+	ckpt_write(fp, queue, memsize * sizeof(int));
+}
+
+void load(FILE *fp) {
+	ckpt_read(fp, &head, sizeof(head));
+	ckpt_read(fp, &count, sizeof(count));
+	ckpt_read(fp, &faults, sizeof(faults));
+	ckpt_read(fp, &evictions, sizeof(evictions));
+	ckpt_read(fp, queue, memsize * sizeof(int));
+}
+
+void init() {
+	queue = malloc(memsize * sizeof(int));
+	if (queue == NULL) {
+		perror("Failed to allocate FIFO queue");
+		exit(1);
+	}
+	head = count = 0;
+	arriving = NULL;
+	faults = evictions = 0;
+}
+
+void report() {
+	printf("Plugin saw %d faults and %d evictions\n", faults, evictions);
+}
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include "sim.h"
+#include "pagetable.h"
+
+/* The registry of eviction algorithms that -a can name.
+ *
+ * The built-in algorithms are registered from builtin_algs at startup.
+ * Any other name containing a '/' is taken to be a shared object and is
+ * loaded with dlopen, so a new policy can be tried with
+ *
+ *     sim -a ./mypolicy.so ...
+ *
+ * without relinking the simulator. The object must export functions named
+ * init, ref and evict with the same signatures as the built-in ones, and
+ * may also export:
+ *     void report(void)                      - print extra results at exit
+ *     void on_fault(pgtbl_entry_t *p)        - p missed, before a frame is
+ *                                              allocated for it
+ *     void on_evict(int frame, pgtbl_entry_t *victim)
+ *                                            - victim has been unmapped from
+ *                                              frame (and written to swap if
+ *                                              it was dirty)
+ *     void fill(pgtbl_entry_t *p)            - p was brought in without being
+ *                                              referenced (e.g. as part of a
+ *                                              huge page); ref is used if
+ *                                              there is no fill
+ *     int evict_local(int pid)               - like evict, but the victim
+ *                                              must be a page of process
+ *                                              pid (for --scope local)
+ *     void save(FILE *fp), void load(FILE *fp)
+ *                                            - write the policy's state to
+ *                                              a checkpoint with ckpt_write,
+ *                                              and read it back after init
+ *                                              with ckpt_read (for
+ *                                              --checkpoint-every; see
+ *                                              checkpoint.h)
+ * The simulator is linked with -rdynamic, so the object can use globals
+ * like memsize and coremap directly. See plugins/ for an example.
+ */
+
+static struct functions builtin_algs[] = {
+	{"rand", rand_init, rand_ref, rand_evict, NULL, NULL, NULL, NULL,
+	 rand_evict_local, rand_save, rand_load},
+	{"lru", lru_init, lru_ref, lru_evict, NULL, NULL, NULL, NULL,
+	 lru_evict_local, lru_save, lru_load},
+	{"fifo", fifo_init, fifo_ref, fifo_evict, NULL, NULL, NULL, NULL,
+	 fifo_evict_local, fifo_save, fifo_load},
+	{"clock",clock_init, clock_ref, clock_evict, NULL, NULL, NULL, NULL,
+	 clock_evict_local, clock_save, clock_load},
+	{"opt", opt_init, opt_ref, opt_evict, NULL, NULL, NULL, opt_fill},
+	{"wopt", wopt_init, wopt_ref, wopt_evict, wopt_report, NULL, NULL,
+	 wopt_fill},
+	{"arc", arc_init, arc_ref, arc_evict},
+	{"2q", twoq_init, twoq_ref, twoq_evict},
+	{"lirs", lirs_init, lirs_ref, lirs_evict},
+	{"clockpro", clockpro_init, clockpro_ref, clockpro_evict},
+	{"ws", ws_init, ws_ref, ws_evict, ws_report, NULL, NULL, ws_fill,
+	 ws_evict_local},
+	{"pff", pff_init, ws_ref, ws_evict, ws_report, NULL, NULL, ws_fill,
+	 ws_evict_local}
+};
+
+struct functions *algs = NULL;
+const char *algorithm_name = NULL;    // Name of the selected algorithm
+int num_algs = 0;
+static int algs_cap = 0;
+
+/* Adds an algorithm to the registry. The structure is copied, but the
+ * name it points to must stay valid.
+ */
+void register_algorithm(const struct functions *f) {
+	if (num_algs == algs_cap) {
+		algs_cap = algs_cap ? 2 * algs_cap : 16;
+		algs = realloc(algs, algs_cap * sizeof(struct functions));
+		if (algs == NULL) {
+			perror("Failed to allocate algorithm table");
+			exit(1);
+		}
+	}
+	algs[num_algs++] = *f;
+}
+
+void register_builtin_algorithms() {
+	int i;
+	for (i = 0; i < sizeof(builtin_algs) / sizeof(builtin_algs[0]); i++) {
+		register_algorithm(&builtin_algs[i]);
+	}
+}
+
+/* Loads the policy in the shared object at path and registers it under
+ * that path. Returns 0 on success, -1 (after printing why) on failure.
+ */
+static int load_algorithm(const char *path) {
+	struct functions f;
+	void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+
+	if (handle == NULL) {
+		fprintf(stderr, "Error: %s\n", dlerror());
+		return -1;
+	}
+	memset(&f, 0, sizeof(f));
+	f.name = strdup(path);
+	*(void **)&f.init = dlsym(handle, "init");
+	*(void **)&f.ref = dlsym(handle, "ref");
+	*(void **)&f.evict = dlsym(handle, "evict");
+	*(void **)&f.report = dlsym(handle, "report");
+	*(void **)&f.on_fault = dlsym(handle, "on_fault");
+	*(void **)&f.on_evict = dlsym(handle, "on_evict");
+	*(void **)&f.fill = dlsym(handle, "fill");
+	*(void **)&f.evict_local = dlsym(handle, "evict_local");
+	*(void **)&f.save = dlsym(handle, "save");
+	*(void **)&f.load = dlsym(handle, "load");
+	if (f.init == NULL || f.ref == NULL || f.evict == NULL) {
+		fprintf(stderr, "Error: %s must define init, ref and evict\n", path);
+		dlclose(handle);
+		free(f.name);
+		return -1;
+	}
+	register_algorithm(&f);
+	return 0;
+}
+
+/* Looks up the named eviction algorithm and installs its functions,
+ * loading it first if it names a shared object.
+ * Returns 0 on success, -1 if there is no such algorithm.
+ */
+int select_algorithm(const char *name) {
+	int i;
+	for (i = 0; i < num_algs; i++) {
+		if(strcmp(algs[i].name, name) == 0) {
+			init_fcn = algs[i].init;
+			ref_fcn = algs[i].ref;
+			evict_fcn = algs[i].evict;
+			report_fcn = algs[i].report;
+			on_fault_fcn = algs[i].on_fault;
+			on_evict_fcn = algs[i].on_evict;
+			fill_fcn = algs[i].fill ? algs[i].fill : algs[i].ref;
+			evict_local_fcn = algs[i].evict_local;
+			save_fcn = algs[i].save;
+			load_fcn = algs[i].load;
+			algorithm_name = algs[i].name;
+			return 0;
+		}
+	}
+	if (strchr(name, '/') != NULL && load_algorithm(name) == 0) {
+		return select_algorithm(name);
+	}
+	return -1;
+}
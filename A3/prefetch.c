@@ -0,0 +1,442 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "pagetable.h"
+#include "sim.h"
+#include "pagemap.h"
+#include "interval.h"
+#include "stats.h"
+#include "prefetch.h"
+
+/* Prefetching on the fault path, enabled with --prefetch name[,N].
+ *
+ * On a fault, the prefetcher may name other pages it expects to be used
+ * soon, up to N of them (default 8). Those that are not in memory are
+ * brought in before the faulting page, as part of the same fault, and
+ * the replacement algorithm is told about them through fill_fcn. The
+ * first reference to a prefetched page may also trigger more prefetching,
+ * which is done before the next reference, as if it had been read ahead
+ * asynchronously in the meantime.
+ *
+ *   seq     Sequential read-ahead with an adaptive window, like Linux's
+ *           readahead: a fault reads ahead a window of 2 pages. Faulting
+ *           just past the window, or using the first page of the window,
+ *           means the access is sequential, so the next window is read with
+ *           twice the size, up to N.
+ *   stride  Finds the stride between successive faults in each of up to 16
+ *           address streams, told apart only by how close the addresses
+ *           are, since traces have no PCs. Once the same stride is seen
+ *           twice in a row, the next N pages along it are fetched.
+ *   markov  Remembers which pages faulted after each page, up to 4, and on
+ *           a fault on a page prefetches those that followed it before.
+ *           Uses of prefetched pages count as the faults they replaced.
+ *
+ * Prefetched pages carry PG_PREFETCH until they are first referenced, so
+ * the report can give the accuracy (prefetched pages that were used) and
+ * the coverage (faults that prefetching took care of). For the change in
+ * miss rate, the same trace is also simulated without prefetching, in a
+ * child process, while this one runs.
+ */
+
+#define PREFETCH_MAX     256     // Most pages per prefetch
+#define NUM_PIDS         (TRACE_MAX_PID + 1)
+#define SEQ_INITIAL      2
+#define STRIDE_STREAMS   16
+#define STRIDE_DISTANCE  64      // Pages between faults in one stream
+#define MARKOV_SUCC      4
+
+struct prefetcher {
+	char *name;
+	void (*init)(void);
+	void (*fault)(int pid, unsigned long page);  // Demand fault on page
+	void (*use)(int pid, unsigned long page);    // First use of a
+	                                             // prefetched page
+};
+
+int prefetch_degree = 8;
+struct prefetcher *prefetcher = NULL;
+unsigned long prefetch_unused = 0;    // Prefetched pages evicted unused
+
+static unsigned long cand[PREFETCH_MAX]; // Pages to prefetch next
+static int num_cand;
+static int cand_pid;
+
+static unsigned long prefetched = 0;
+static unsigned long prefetch_used = 0;
+static unsigned long prefetch_faults = 0;  // Faults that prefetched
+
+static pid_t baseline = -1;           // Demand paging run, or -1
+static int baseline_fd;
+
+/* Adds page to the pages to prefetch for process pid. */
+static void want(int pid, unsigned long page) {
+	if (num_cand < prefetch_degree) {
+		cand_pid = pid;
+		cand[num_cand++] = page;
+	}
+}
+
+//---------------------------------------------------------------------
+// Sequential read-ahead.
+
+struct seq_stream {
+	unsigned long next;      // First page after the window
+	unsigned long marker;    // First page of the window
+	int window;              // Size of the window, 0 before the first
+};
+
+static struct seq_stream seq[NUM_PIDS];
+
+static void seq_init() {
+	memset(seq, 0, sizeof(seq));
+}
+
+static void seq_read_ahead(int pid, unsigned long start) {
+	struct seq_stream *s = &seq[pid];
+	int i;
+
+	for (i = 0; i < s->window; i++) {
+		want(pid, start + i);
+	}
+	s->marker = start;
+	s->next = start + s->window;
+}
+
+static void seq_grow(struct seq_stream *s) {
+	s->window = 2 * s->window < prefetch_degree ? 2 * s->window :
+		prefetch_degree;
+}
+
+static void seq_fault(int pid, unsigned long page) {
+	struct seq_stream *s = &seq[pid];
+
+	if (s->window > 0 && page == s->next) {
+		seq_grow(s);
+	} else {
+		s->window = SEQ_INITIAL < prefetch_degree ? SEQ_INITIAL :
+			prefetch_degree;
+	}
+	seq_read_ahead(pid, page + 1);
+}
+
+static void seq_use(int pid, unsigned long page) {
+	struct seq_stream *s = &seq[pid];
+
+	if (page == s->marker) {
+		seq_grow(s);
+		seq_read_ahead(pid, s->next);
+	}
+}
+
+//---------------------------------------------------------------------
+// Stride detection.
+
+struct stride_stream {
+	int pid;
+	unsigned long last;      // Last page of the stream
+	long stride;             // Pages between its last two faults
+	int confirmed;           // The stride was seen twice in a row
+	unsigned long used;      // When it was last matched, for replacement
+};
+
+static struct stride_stream streams[STRIDE_STREAMS];
+static unsigned long stride_clock;
+
+static void stride_init() {
+	memset(streams, 0, sizeof(streams));
+	stride_clock = 0;
+}
+
+static void stride_fault(int pid, unsigned long page) {
+	struct stride_stream *s = NULL;
+	long dist, best = STRIDE_DISTANCE + 1;
+	int i;
+
+	// The stream whose last fault is nearest, if near enough
+	for (i = 0; i < STRIDE_STREAMS; i++) {
+		if (streams[i].used == 0 || streams[i].pid != pid) {
+			continue;
+		}
+		dist = labs((long)(page - streams[i].last));
+		if (dist < best) {
+			best = dist;
+			s = &streams[i];
+		}
+	}
+	if (s == NULL) {
+		s = &streams[0];
+		for (i = 1; i < STRIDE_STREAMS; i++) {
+			if (streams[i].used < s->used) {
+				s = &streams[i];
+			}
+		}
+		s->pid = pid;
+		s->last = page;
+		s->stride = 0;
+		s->confirmed = 0;
+		s->used = ++stride_clock;
+		return;
+	}
+	s->used = ++stride_clock;
+	if (page == s->last) {
+		return;
+	}
+	dist = (long)(page - s->last);
+	s->confirmed = dist == s->stride;
+	s->stride = dist;
+	s->last = page;
+	if (s->confirmed) {
+		for (i = 1; i <= prefetch_degree; i++) {
+			want(pid, page + i * s->stride);
+		}
+		// Carry on from the last page fetched
+		s->last = page + prefetch_degree * s->stride;
+	}
+}
+
+//---------------------------------------------------------------------
+// Markov prediction.
+
+struct markov_entry {
+	unsigned long succ[MARKOV_SUCC];  // Pages that faulted next, most
+	int nsucc;                        // recent first
+};
+
+static struct pagemap *markov_index;  // TRACE_PAGE -> markov_table
+static struct markov_entry *markov_table;
+static long markov_size, markov_cap;
+static unsigned long markov_prev[NUM_PIDS];  // Last fault, plus one
+
+static void markov_init() {
+	markov_index = pagemap_create(1024);
+	markov_table = NULL;
+	markov_size = markov_cap = 0;
+	memset(markov_prev, 0, sizeof(markov_prev));
+}
+
+static struct markov_entry *markov_get(int pid, unsigned long page) {
+	unsigned long key = TRACE_PAGE(pid, page << PAGE_SHIFT);
+	long *idx = pagemap_lookup(markov_index, key);
+
+	if (idx != NULL) {
+		return &markov_table[*idx];
+	}
+	if (markov_size == markov_cap) {
+		markov_cap = markov_cap ? 2 * markov_cap : 1024;
+		markov_table = realloc(markov_table,
+				       markov_cap * sizeof(struct markov_entry));
+		if (markov_table == NULL) {
+			perror("Failed to allocate Markov table");
+			exit(1);
+		}
+	}
+	markov_table[markov_size].nsucc = 0;
+	pagemap_insert(markov_index, key, markov_size);
+	return &markov_table[markov_size++];
+}
+
+static void markov_fault(int pid, unsigned long page) {
+	struct markov_entry *e;
+	int i;
+
+	if (markov_prev[pid] != 0 && markov_prev[pid] - 1 != page) {
+		// Move page to the front of the previous fault's successors
+		e = markov_get(pid, markov_prev[pid] - 1);
+		for (i = 0; i < e->nsucc && e->succ[i] != page; i++) {
+		}
+		if (i == MARKOV_SUCC) {
+			i--;    // The oldest drops out
+		} else if (i == e->nsucc) {
+			e->nsucc++;
+		}
+		for (; i > 0; i--) {
+			e->succ[i] = e->succ[i - 1];
+		}
+		e->succ[0] = page;
+	}
+	markov_prev[pid] = page + 1;
+
+	e = markov_get(pid, page);
+	for (i = 0; i < e->nsucc; i++) {
+		want(pid, e->succ[i]);
+	}
+}
+
+static struct prefetcher prefetchers[] = {
+	{"seq", seq_init, seq_fault, seq_use},
+	{"stride", stride_init, stride_fault, NULL},
+	{"markov", markov_init, markov_fault, markov_fault},
+};
+
+//---------------------------------------------------------------------
+
+/* Parses "name[,N]". Returns 0 on success, -1 if spec is invalid. */
+int prefetch_configure(char *spec) {
+	char *comma = strchr(spec, ',');
+	size_t len = comma ? (size_t)(comma - spec) : strlen(spec);
+	int i;
+
+	prefetcher = NULL;
+	for (i = 0; i < sizeof(prefetchers) / sizeof(prefetchers[0]); i++) {
+		if (strlen(prefetchers[i].name) == len &&
+		    strncmp(prefetchers[i].name, spec, len) == 0) {
+			prefetcher = &prefetchers[i];
+		}
+	}
+	if (prefetcher == NULL) {
+		return -1;
+	}
+	if (comma != NULL) {
+		prefetch_degree = (int)strtol(comma + 1, NULL, 10);
+		if (prefetch_degree < 1 || prefetch_degree > PREFETCH_MAX) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void prefetch_init() {
+	num_cand = 0;
+	prefetcher->init();
+}
+
+/* Brings in the pages in cand that are not in memory, except for the one
+ * at skip, and empties cand.
+ */
+static void prefetch_pages(unsigned long skip) {
+	addr_t limit = pagetable_radix ? 1UL << RADIX_VADDR_BITS :
+		(addr_t)PTRS_PER_PGDIR << PGDIR_SHIFT;
+	struct process *proc = curproc;
+	pgtbl_entry_t *p;
+	addr_t vaddr;
+	int i;
+
+	switch_process(cand_pid);
+	for (i = 0; i < num_cand; i++) {
+		vaddr = cand[i] << PAGE_SHIFT;
+		// A stride can run off either end of the address space
+		if (cand[i] == skip || vaddr >= limit ||
+		    (vaddr >> PAGE_SHIFT) != cand[i]) {
+			continue;
+		}
+		p = lookup_pte(vaddr);
+		if (p->frame & PG_VALID) {
+			continue;
+		}
+		page_in(p, vaddr);
+		p->frame |= PG_PREFETCH;
+		fill_fcn(p);
+		prefetched++;
+	}
+	num_cand = 0;
+	switch_process(proc->pid);
+}
+
+/* Called on a fault at vaddr, before the page is brought in. */
+void prefetch_fault(addr_t vaddr) {
+	unsigned long page = vaddr >> PAGE_SHIFT;
+
+	prefetcher->fault(curproc->pid, page);
+	if (num_cand > 0) {
+		prefetch_faults++;
+		prefetch_pages(page);
+	}
+}
+
+/* Called on the first reference to the prefetched page p at vaddr. */
+void prefetch_use(addr_t vaddr, pgtbl_entry_t *p) {
+	p->frame &= ~PG_PREFETCH;
+	prefetch_used++;
+	if (prefetcher->use != NULL) {
+		// Fetched before the next reference, by prefetch_pending
+		prefetcher->use(curproc->pid, vaddr >> PAGE_SHIFT);
+	}
+}
+
+/* Brings in the pages asked for since the last reference, if any. */
+void prefetch_pending() {
+	if (num_cand > 0) {
+		prefetch_pages(~0UL);
+	}
+}
+
+/* Starts a child that simulates the trace without prefetching, for the
+ * report to compare with. Called before anything is set up, so the child
+ * has a swapfile and trace of its own.
+ */
+void prefetch_baseline_start(unsigned swapsize) {
+	struct trace *tr;
+	int pfd[2];
+	unsigned long counts[2];
+
+	if (tracefile == NULL) {
+		return;    // stdin can only be read once
+	}
+	if (pipe(pfd) == -1) {
+		perror("prefetch: pipe");
+		exit(1);
+	}
+	fflush(stdout);
+	if ((baseline = fork()) == -1) {
+		perror("prefetch: fork");
+		exit(1);
+	}
+	if (baseline == 0) {
+		close(pfd[0]);
+		prefetcher = NULL;
+		interval_refs = 0;
+		stats_enabled = 0;
+		debug = 0;
+		tr = trace_open(tracefile);
+		init_simulation(swapsize);
+		init_fcn();
+		replay_trace(tr);
+		trace_close(tr);
+		swap_destroy();
+		counts[0] = miss_count;
+		counts[1] = ref_count;
+		_exit(write(pfd[1], counts, sizeof(counts)) == sizeof(counts) ?
+		      0 : 1);
+	}
+	close(pfd[1]);
+	baseline_fd = pfd[0];
+}
+
+void prefetch_report() {
+	unsigned long counts[2];
+	int status;
+
+	printf("Prefetch (%s, up to %d pages): %lu faults prefetched %lu pages, "
+	       "%lu used (accuracy %.4f), %lu evicted unused\n",
+	       prefetcher->name, prefetch_degree, prefetch_faults, prefetched,
+	       prefetch_used,
+	       prefetched ? (double)prefetch_used / prefetched * 100 : 0.0,
+	       prefetch_unused);
+	printf("Prefetch coverage: %lu of %lu faults avoided (%.4f)\n",
+	       prefetch_used, prefetch_used + miss_count,
+	       prefetch_used + miss_count ?
+	       (double)prefetch_used / (prefetch_used + miss_count) * 100 : 0.0);
+
+	if (baseline == -1) {
+		return;
+	}
+	while (waitpid(baseline, &status, 0) == -1 && errno == EINTR) {
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+	    read(baseline_fd, counts, sizeof(counts)) != sizeof(counts)) {
+		fprintf(stderr, "prefetch: simulation without prefetching failed\n");
+		close(baseline_fd);
+		return;
+	}
+	close(baseline_fd);
+	printf("Demand paging: %lu misses (miss rate %.4f), with prefetching "
+	       "%lu (%.4f), change %+.4f\n", counts[0],
+	       (double)counts[0] / counts[1] * 100, miss_count,
+	       (double)miss_count / ref_count * 100,
+	       (double)miss_count / ref_count * 100 -
+	       (double)counts[0] / counts[1] * 100);
+}
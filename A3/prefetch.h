@@ -0,0 +1,23 @@
+#ifndef __PREFETCH_H__
+#define __PREFETCH_H__
+
+#include "pagetable.h"
+
+/* Prefetching on faults for --prefetch seq|stride|markov[,N] (see
+ * prefetch.c). prefetch_fault runs in the fault path before the demand
+ * page is brought in, and prefetch_use on the first hit of a prefetched
+ * page (PG_PREFETCH).
+ */
+extern struct prefetcher *prefetcher;   // NULL if not prefetching
+extern int prefetch_degree;
+extern unsigned long prefetch_unused;
+
+extern int prefetch_configure(char *spec);
+extern void prefetch_init(void);
+extern void prefetch_fault(addr_t vaddr);
+extern void prefetch_use(addr_t vaddr, pgtbl_entry_t *p);
+extern void prefetch_pending(void);
+extern void prefetch_baseline_start(unsigned swapsize);
+extern void prefetch_report(void);
+
+#endif /* __PREFETCH_H__ */
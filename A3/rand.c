@@ -5,11 +5,16 @@
 #include <stdlib.h>
 #include "sim.h"
 #include "pagetable.h"
+#include "checkpoint.h"
 
 
 
 extern struct frame *coremap;
 
+// The generator's state, kept here rather than in the C library so that a
+// checkpoint can save it
+static char rand_state[128];
+
 /* Page to evict is chosen using the rand algorithm.
  * Returns the page frame number (which is also the index in the coremap)
  * for the page that is to be evicted.
@@ -21,6 +26,18 @@ int rand_evict() {
 	return idx;
 }
 
+/* Like rand_evict, but only frames holding a page of process pid are
+ * chosen. The process must have at least one page in memory.
+ */
+int rand_evict_local(int pid) {
+	int idx;
+
+	do {
+		idx = (int)(random() % memsize);
+	} while (coremap[idx].pid != pid);
+	return idx;
+}
+
 /* This function is called on each access to a page to update any information
  * needed by the rand algorithm.
  * Input: The page table entry for the page that is being accessed.
@@ -31,4 +48,22 @@ void rand_ref(pgtbl_entry_t *p) {
 }
 
 void rand_init() {
+	// The same sequence random() gives when it has not been seeded
+	initstate(1, rand_state, sizeof(rand_state));
+}
+
+void rand_save(FILE *fp) {
+	// Makes random() store its position in the state, then writes it
+	setstate(rand_state);
+	ckpt_write(fp, rand_state, sizeof(rand_state));
+}
+
+void rand_load(FILE *fp) {
+	char scratch[sizeof(rand_state)];
+
+	// setstate first stores the position of the state in use, which would
+	// overwrite the one read in if that is rand_state, so move off it
+	initstate(1, scratch, sizeof(scratch));
+	ckpt_read(fp, rand_state, sizeof(rand_state));
+	setstate(rand_state);
 }
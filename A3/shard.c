@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "sim.h"
+
+/* Sharded replay (-j N) models memory split into N sets by a hash of the
+ * page number, like a set-associative page cache, with the replacement
+ * algorithm run separately in each set. Since no page ever moves between
+ * sets, each set can be simulated on its own core.
+ *
+ * Like sweep mode, each shard is a forked worker process, because the
+ * simulator keeps all its state in globals: each worker has its own
+ * coremap of memsize / N frames (the first memsize % N get one more), its
+ * own page tables, swapfile and algorithm state. The parent parses the
+ * trace once and hands every reference to the worker owning its page
+ * through a single-producer, single-consumer ring in shared memory. The
+ * rings are lock-free: the producer only writes tail and the consumer
+ * only writes head, each publishing the slots it has finished with a
+ * release store. Each side waits by yielding the CPU, as a worker that
+ * blocks in the kernel would make the parser wait for it.
+ *
+ * At the end each worker sends its counters back over a pipe and the
+ * parent adds them up.
+ */
+
+#define RING_SIZE    (1 << 16)   // References per ring, a power of two
+#define RING_BATCH   256         // References between index updates
+
+struct ring {
+	_Atomic uint64_t head;   // Next slot the worker will read
+	char pad1[64 - sizeof(uint64_t)];
+	_Atomic uint64_t tail;   // Next slot the parser will write
+	_Atomic int done;        // Set once tail covers the whole trace
+	char pad2[64 - sizeof(uint64_t) - sizeof(int)];
+	trace_ref_t refs[RING_SIZE];
+};
+
+struct shard_result {
+	unsigned long hit_count;
+	unsigned long miss_count;
+	unsigned long ref_count;
+	unsigned long evict_clean_count;
+	unsigned long evict_dirty_count;
+};
+
+struct shard {
+	struct ring *ring;
+	unsigned memsize;
+	pid_t pid;
+	int fd;                  // Read end of the pipe from the worker
+	uint64_t tail;           // Parser's copy of ring->tail
+	uint64_t head;           // Parser's last view of ring->head
+	struct shard_result res;
+};
+
+/* Returns the shard that the page of a packed reference belongs to. */
+static int shard_of(trace_ref_t r, int nshards) {
+	unsigned long page = TRACE_REF_PAGE(r);
+
+	// Fibonacci hashing, as in pagemap.c, so that runs of consecutive
+	// pages spread evenly across the shards
+	return (int)(((page * 0x9E3779B97F4A7C15UL) >> 32) % nshards);
+}
+
+/* Replays the references that arrive on the shard's ring, then writes
+ * the counters to fd. Runs in the worker process and never returns.
+ */
+static void shard_worker(struct shard *s, unsigned swapsize, int fd) {
+	struct ring *ring = s->ring;
+	struct shard_result r;
+	uint64_t head = 0, tail;
+	int done;
+
+	memsize = s->memsize;
+	init_simulation(swapsize);
+	init_fcn();
+
+	while (1) {
+		// Read done before tail, so nothing published before done is missed
+		done = atomic_load_explicit(&ring->done, memory_order_acquire);
+		tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+		if (head == tail) {
+			if (done) {
+				break;
+			}
+			sched_yield();
+			continue;
+		}
+		while (head < tail) {
+			trace_ref_t ref = ring->refs[head % RING_SIZE];
+
+			switch_process(TRACE_REF_PID(ref));
+			access_mem(TRACE_REF_TYPE(ref), TRACE_REF_VADDR(ref));
+			if (++head % RING_BATCH == 0) {
+				atomic_store_explicit(&ring->head, head,
+						      memory_order_release);
+			}
+		}
+		atomic_store_explicit(&ring->head, head, memory_order_release);
+	}
+	swap_destroy();
+
+	r.hit_count = hit_count;
+	r.miss_count = miss_count;
+	r.ref_count = ref_count;
+	r.evict_clean_count = evict_clean_count;
+	r.evict_dirty_count = evict_dirty_count;
+	if (write(fd, &r, sizeof(r)) != sizeof(r)) {
+		perror("shard: failed to report results");
+		_exit(1);
+	}
+	_exit(0);
+}
+
+static void shard_start(struct shard *s, unsigned swapsize) {
+	int pfd[2];
+
+	if (pipe(pfd) == -1) {
+		perror("shard: pipe");
+		exit(1);
+	}
+	if ((s->pid = fork()) == -1) {
+		perror("shard: fork");
+		exit(1);
+	}
+	if (s->pid == 0) {
+		close(pfd[0]);
+		shard_worker(s, swapsize, pfd[1]);
+	}
+	close(pfd[1]);
+	s->fd = pfd[0];
+}
+
+/* Tells every worker the trace has ended and exits, after an error in
+ * the parser or in a worker it was waiting for.
+ */
+static void shard_abort(struct shard *shards, int nshards) {
+	int i;
+
+	for (i = 0; i < nshards; i++) {
+		atomic_store_explicit(&shards[i].ring->done, 1, memory_order_release);
+	}
+	exit(1);
+}
+
+/* Publishes the references written to the shard's ring so far. */
+static void shard_publish(struct shard *s) {
+	atomic_store_explicit(&s->ring->tail, s->tail, memory_order_release);
+}
+
+/* Appends one reference to the shard's ring, waiting for the worker if
+ * the ring is full. Returns 0, or -1 if the worker has died.
+ */
+static int shard_push(struct shard *s, trace_ref_t ref) {
+	int status;
+
+	while (s->tail - s->head == RING_SIZE) {
+		shard_publish(s);
+		s->head = atomic_load_explicit(&s->ring->head, memory_order_acquire);
+		if (s->tail - s->head == RING_SIZE) {
+			if (waitpid(s->pid, &status, WNOHANG) == s->pid) {
+				return -1;
+			}
+			sched_yield();
+		}
+	}
+	s->ring->refs[s->tail % RING_SIZE] = ref;
+	if (++s->tail % RING_BATCH == 0) {
+		shard_publish(s);
+	}
+	return 0;
+}
+
+/* Simulates the trace with memory split into nshards sets, one per worker
+ * process, and prints the combined counters.
+ * Returns the exit status for sim.
+ */
+int run_sharded(unsigned total_memsize, unsigned swapsize, int nshards) {
+	struct shard *shards = calloc(nshards, sizeof(struct shard));
+	struct trace *tr;
+	struct shard_result sum;
+	char type;
+	addr_t vaddr;
+	int i, status, failed = 0;
+
+	if (shards == NULL) {
+		perror("Failed to allocate shards");
+		exit(1);
+	}
+	if (total_memsize < (unsigned)nshards) {
+		fprintf(stderr, "Error: -j %d needs at least %d frames\n",
+				nshards, nshards);
+		exit(1);
+	}
+	tr = trace_open(tracefile);
+	fflush(stdout);
+
+	for (i = 0; i < nshards; i++) {
+		shards[i].memsize = total_memsize / nshards +
+			(i < total_memsize % nshards ? 1 : 0);
+		shards[i].ring = mmap(NULL, sizeof(struct ring),
+				      PROT_READ | PROT_WRITE,
+				      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (shards[i].ring == MAP_FAILED) {
+			perror("shard: failed to map ring");
+			exit(1);
+		}
+		shard_start(&shards[i], swapsize);
+	}
+
+	while (trace_next(tr, &type, &vaddr)) {
+		trace_ref_t ref;
+
+		if (vaddr >> TRACE_VADDR_BITS) {
+			fprintf(stderr, "Error: address %lx in trace is wider than %d "
+				"bits\n", vaddr, TRACE_VADDR_BITS);
+			shard_abort(shards, nshards);
+		}
+		ref = TRACE_REF(type, tr->pid, vaddr);
+		i = shard_of(ref, nshards);
+		if (shard_push(&shards[i], ref) != 0) {
+			fprintf(stderr, "shard: simulation of shard %d failed\n", i);
+			shard_abort(shards, nshards);
+		}
+	}
+	trace_close(tr);
+	for (i = 0; i < nshards; i++) {
+		shard_publish(&shards[i]);
+		atomic_store_explicit(&shards[i].ring->done, 1, memory_order_release);
+	}
+
+	memset(&sum, 0, sizeof(sum));
+	for (i = 0; i < nshards; i++) {
+		struct shard *s = &shards[i];
+
+		while (waitpid(s->pid, &status, 0) == -1 && errno == EINTR) {
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+		    read(s->fd, &s->res, sizeof(s->res)) != sizeof(s->res)) {
+			fprintf(stderr, "shard: simulation of shard %d failed\n", i);
+			failed = 1;
+		}
+		close(s->fd);
+		munmap(s->ring, sizeof(struct ring));
+
+		sum.hit_count += s->res.hit_count;
+		sum.miss_count += s->res.miss_count;
+		sum.ref_count += s->res.ref_count;
+		sum.evict_clean_count += s->res.evict_clean_count;
+		sum.evict_dirty_count += s->res.evict_dirty_count;
+	}
+	if (failed) {
+		return 1;
+	}
+
+	for (i = 0; i < nshards; i++) {
+		struct shard_result *r = &shards[i].res;
+		printf("Shard %d: %u frames, %lu references, %lu hits, %lu misses, "
+		       "%lu clean and %lu dirty evictions\n", i, shards[i].memsize,
+		       r->ref_count, r->hit_count, r->miss_count,
+		       r->evict_clean_count, r->evict_dirty_count);
+	}
+	free(shards);
+
+	printf("\n");
+	printf("Hit count: %lu\n", sum.hit_count);
+	printf("Miss count: %lu\n", sum.miss_count);
+	printf("Clean evictions: %lu\n", sum.evict_clean_count);
+	printf("Dirty evictions: %lu\n", sum.evict_dirty_count);
+	printf("Total references : %lu\n", sum.ref_count);
+	printf("Hit rate: %.4f\n", (double)sum.hit_count/sum.ref_count * 100);
+	printf("Miss rate: %.4f\n", (double)sum.miss_count/sum.ref_count *100);
+	return 0;
+}
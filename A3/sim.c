@@ -6,6 +6,14 @@
 #include <string.h>
 #include "sim.h"
 #include "pagetable.h"
+#include "trace.h"
+#include "stats.h"
+#include "interval.h"
+#include "checkpoint.h"
+#include "tlb.h"
+#include "huge.h"
+#include "prefetch.h"
+#include "cleaner.h"
 
 // Define global variables declared in sim.h
 unsigned memsize = 0;
@@ -13,23 +21,21 @@ int debug = 0;
 char *physmem = NULL;
 struct frame *coremap = NULL;
 char *tracefile = NULL;
-
-/* The algs array gives us a mapping between the name of an eviction
- * algorithm as given in a command line argument, and the function to
- * call to select the victim page.
- */
-struct functions algs[] = {
-	{"rand", rand_init, rand_ref, rand_evict}, 
-	{"lru", lru_init, lru_ref, lru_evict},
-	{"fifo", fifo_init, fifo_ref, fifo_evict},
-	{"clock",clock_init, clock_ref, clock_evict},
-	{"opt", opt_init, opt_ref, opt_evict}
-};
-int num_algs = 5;
+trace_ref_t *trace_buffer = NULL;
+uint64_t trace_buffer_len = 0;
+unsigned long opt_window = 4UL << 20;
+int opt_compare = 0;
 
 void (*init_fcn)() = NULL;
 void (*ref_fcn)(pgtbl_entry_t *) = NULL;
 int (*evict_fcn)() = NULL;
+void (*report_fcn)(void) = NULL;
+void (*on_fault_fcn)(pgtbl_entry_t *) = NULL;
+void (*on_evict_fcn)(int, pgtbl_entry_t *) = NULL;
+void (*fill_fcn)(pgtbl_entry_t *) = NULL;
+int (*evict_local_fcn)(int) = NULL;
+void (*save_fcn)(FILE *) = NULL;
+void (*load_fcn)(FILE *) = NULL;
 
 
 /* An actual memory access based on the vaddr from the trace file.
@@ -63,40 +69,150 @@ void access_mem(char type, addr_t vaddr) {
 }
 
 
-void replay_trace(FILE *infp) {
-	char buf[MAXLINE];
+/* Opens the trace being simulated from the start. Replacement algorithms
+ * that need to see the whole trace up front (like OPT) use this so that
+ * they get the in-memory copy when there is one.
+ */
+struct trace *sim_trace_open() {
+	if (trace_buffer != NULL) {
+		return trace_open_buffer(trace_buffer, trace_buffer_len);
+	}
+	return trace_open(tracefile);
+}
+
+/* Returns the next reference of tr, timed as parsing for --stats. */
+static int next_ref(struct trace *tr, char *type, addr_t *vaddr) {
+	int more;
+
+	STATS_START(PHASE_PARSE);
+	more = trace_next(tr, type, vaddr);
+	STATS_STOP(PHASE_PARSE);
+	return more;
+}
+
+void replay_trace(struct trace *tr) {
 	addr_t vaddr = 0;
 	char type;
 
-	while(fgets(buf, MAXLINE, infp) != NULL) {
-		if(buf[0] != '=') {
-			sscanf(buf, "%c %lx", &type, &vaddr);
-			if(debug)  {
+	while(next_ref(tr, &type, &vaddr)) {
+		if(debug)  {
+			if (tr->pid != 0) {
+				printf("%c %lx %d\n", type, vaddr, tr->pid);
+			} else {
 				printf("%c %lx\n", type, vaddr);
 			}
-			access_mem(type, vaddr);
-		} else {
-			continue;
 		}
-
+		switch_process(tr->pid);
+		access_mem(type, vaddr);
+		if (interval_refs) {
+			interval_ref(tr->pid, vaddr);
+		}
+		if (checkpoint_every) {
+			checkpoint_ref(tr);
+		}
 	}
 }
 
 
+/* Initialize main data structures for simulation.
+ * This happens before calling the replacement algorithm init function
+ * so that the init_fcn can refer to the coremap if needed.
+ */
+void init_simulation(unsigned swapsize) {
+	coremap = calloc(memsize, sizeof(struct frame));
+	physmem = malloc(memsize * SIMPAGESIZE);
+	swap_init(swapsize);
+	init_pagetable();
+	tlb_init();
+}
+
 int main(int argc, char *argv[]) {
 	int opt;
 	unsigned swapsize = 4096;
-	FILE *tfp = stdin;
+	int sweep = 0;
+	int curve = 0;
+	int shards = 1;
+	char *stats_file = NULL;
+	char *interval_file = NULL;
+	char *resume_file = NULL;
+	FILE *stats_fp;
+	char *memsize_arg = NULL;
+	struct trace *tr;
 	char *replacement_alg = NULL;
-	char *usage = "USAGE: sim -f tracefile -m memorysize -s swapsize -a algorithm\n";
+	char *usage = "USAGE: sim -f tracefile -m memorysize -s swapsize -a algorithm\n"
+		"       sim --sweep -f tracefile -m size[,size...] -s swapsize -a alg[,alg...]\n"
+		"       sim --curve -f tracefile [-m maxsize] [-a lru,opt]\n"
+		"       sim -j N -f tracefile -m memorysize -s swapsize -a algorithm\n"
+		"           splits memory into N sets by page hash, simulates each\n"
+		"           set in its own worker and reports the combined counts\n"
+		"The algorithm may also be the path of a policy .so, e.g. ./mypolicy.so\n"
+		"Options: -w window    lookahead window for wopt (default 4194304)\n"
+		"         --tau N      working set window for ws (default 10000)\n"
+		"         --pff N      fault interval above which pff shrinks the\n"
+		"                      resident set (default 1000)\n"
+		"         -S backend   swap I/O: file, batch or mmap (default batch),\n"
+		"                      and report its system calls and slot use\n"
+		"         -P layout    page table: 2level (36-bit addresses, default)\n"
+		"                      or radix (48-bit, allocated as needed)\n"
+		"         --tlb entries,ways[,lru|random]  model a TLB\n"
+		"         --huge N     promote a 2 MiB region to a huge page once N of\n"
+		"                      its 512 pages are resident (needs -P radix and\n"
+		"                      at least 1024 frames)\n"
+		"         --scope global|local  with several processes in the trace,\n"
+		"                      evict from any of them (default), or from the\n"
+		"                      faulting one once it has its share of memory\n"
+		"                      (rand, fifo, lru and clock)\n"
+		"         --compare-opt  report exact OPT misses alongside wopt\n"
+		"         --stats file write the time spent in each phase, and the\n"
+		"                      CPU counters if available, as JSON to file\n"
+		"                      (- for stdout)\n"
+		"         --interval N[,csv|bin]  every N references, write the\n"
+		"                      window's misses, evictions, distinct pages,\n"
+		"                      and the frames and swap slots in use\n"
+		"         --interval-file file  where to write them (default\n"
+		"                      stdout, which only csv may use)\n"
+		"         --checkpoint-every N  save the simulation to the\n"
+		"                      --checkpoint-file every N references\n"
+		"                      (rand, fifo, lru and clock)\n"
+		"         --prefetch seq|stride|markov[,N]  on a fault, also bring\n"
+		"                      in up to N (default 8) pages the prefetcher\n"
+		"                      expects to be used soon\n"
+		"         --cleaner LOW[,HIGH[,US]]  write dirty pages out in the\n"
+		"                      background when fewer than LOW frames are\n"
+		"                      free or clean, until HIGH (default 2*LOW)\n"
+		"                      are; a page write takes US microseconds\n"
+		"                      (default 100) in the latency model\n"
+		"         --resume file  carry on from a checkpoint, with the -m,\n"
+		"                      -s, -a, -S, -P and --scope it was taken with\n";
+	struct option long_opts[] = {
+		{"sweep", no_argument, NULL, 'W'},
+		{"curve", no_argument, NULL, 'C'},
+		{"compare-opt", no_argument, NULL, 'O'},
+		{"tlb", required_argument, NULL, 'T'},
+		{"huge", required_argument, NULL, 'H'},
+		{"scope", required_argument, NULL, 'L'},
+		{"tau", required_argument, NULL, 'U'},
+		{"pff", required_argument, NULL, 'F'},
+		{"stats", required_argument, NULL, 'Z'},
+		{"interval", required_argument, NULL, 'I'},
+		{"interval-file", required_argument, NULL, 'V'},
+		{"checkpoint-every", required_argument, NULL, 'K'},
+		{"checkpoint-file", required_argument, NULL, 'Q'},
+		{"resume", required_argument, NULL, 'R'},
+		{"prefetch", required_argument, NULL, 'X'},
+		{"cleaner", required_argument, NULL, 'D'},
+		{NULL, 0, NULL, 0}
+	};
+
+	register_builtin_algorithms();
 
-	while ((opt = getopt(argc, argv, "f:m:a:s:")) != -1) {
+	while ((opt = getopt_long(argc, argv, "f:m:a:s:w:S:P:j:", long_opts, NULL)) != -1) {
 		switch (opt) {
 		case 'f':
 			tracefile = optarg;
 			break;
 		case 'm':
-			memsize = (unsigned)strtoul(optarg, NULL, 10);
+			memsize_arg = optarg;
 			break;
 		case 'a':
 			replacement_alg = optarg;
@@ -104,63 +220,297 @@ int main(int argc, char *argv[]) {
 		case 's':
 			swapsize = (unsigned)strtoul(optarg, NULL, 10);
 			break;
+		case 'W':
+			sweep = 1;
+			break;
+		case 'j':
+			shards = (int)strtol(optarg, NULL, 10);
+			if (shards < 1) {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'C':
+			curve = 1;
+			break;
+		case 'w':
+			opt_window = strtoul(optarg, NULL, 10);
+			if (opt_window == 0) {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'O':
+			opt_compare = 1;
+			break;
+		case 'Z':
+			stats_file = optarg;
+			break;
+		case 'I':
+			if (interval_configure(optarg) != 0) {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'V':
+			interval_file = optarg;
+			break;
+		case 'K':
+			checkpoint_every = strtoul(optarg, NULL, 10);
+			if (checkpoint_every == 0) {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'Q':
+			checkpoint_file = optarg;
+			break;
+		case 'R':
+			resume_file = optarg;
+			break;
+		case 'D':
+			if (cleaner_configure(optarg) != 0) {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'X':
+			if (prefetch_configure(optarg) != 0) {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'U':
+			ws_tau = strtoul(optarg, NULL, 10);
+			if (ws_tau == 0) {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'F':
+			pff_threshold = strtoul(optarg, NULL, 10);
+			if (pff_threshold == 0) {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'T':
+			if (tlb_configure(optarg) != 0) {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'H':
+			huge_threshold = (int)strtol(optarg, NULL, 10);
+			if (huge_threshold < 1 || huge_threshold > 512) {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'L':
+			if (strcmp(optarg, "local") == 0) {
+				replace_local = 1;
+			} else if (strcmp(optarg, "global") == 0) {
+				replace_local = 0;
+			} else {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'P':
+			if (strcmp(optarg, "radix") == 0) {
+				pagetable_radix = 1;
+			} else if (strcmp(optarg, "2level") == 0) {
+				pagetable_radix = 0;
+			} else {
+				fprintf(stderr, "%s", usage);
+				exit(1);
+			}
+			break;
+		case 'S':
+			swap_backend = optarg;
+			swap_verbose = 1;
+			if (swap_select(swap_backend) != 0) {
+				fprintf(stderr, "Error: invalid swap backend - %s\n",
+						swap_backend);
+				exit(1);
+			}
+			break;
 		default:
 			fprintf(stderr, "%s", usage);
 			exit(1);
 		}
 	}
-	if(tracefile != NULL) {
-		if((tfp = fopen(tracefile, "r")) == NULL) {
-			perror("Error opening tracefile:");
+	if ((checkpoint_every || resume_file) &&
+	    (curve || sweep || shards > 1 || tlb_entries || huge_threshold ||
+	     interval_refs || prefetcher || cleaner_low)) {
+		fprintf(stderr, "Error: checkpoints cannot be used with --curve, "
+			"--sweep, -j, --tlb, --huge, --interval, --prefetch or "
+			"--cleaner\n");
+		exit(1);
+	}
+	if (cleaner_low && (curve || sweep || shards > 1)) {
+		fprintf(stderr, "Error: --cleaner cannot be used with --curve, "
+			"--sweep or -j\n");
+		exit(1);
+	}
+	if (prefetcher != NULL && (curve || sweep || shards > 1 || huge_threshold)) {
+		fprintf(stderr, "Error: --prefetch cannot be used with --curve, "
+			"--sweep, -j or --huge\n");
+		exit(1);
+	}
+	if (resume_file != NULL) {
+		if (memsize_arg != NULL || replacement_alg != NULL) {
+			fprintf(stderr, "Error: --resume takes -m and -a from the "
+				"checkpoint\n");
 			exit(1);
 		}
+		replacement_alg = resume_open(resume_file, &swapsize);
+		if (checkpoint_every && checkpoint_file == NULL) {
+			checkpoint_file = resume_file;
+		}
+	}
+	if (checkpoint_every && (checkpoint_file == NULL || tracefile == NULL)) {
+		fprintf(stderr, "Error: --checkpoint-every needs --checkpoint-file "
+			"and a trace file (-f)\n");
+		exit(1);
+	}
+	if (curve) {
+		// Miss-ratio curves for every memory size up to -m (default: all)
+		char default_algs[] = "lru,opt";
+		return run_curve(replacement_alg ? replacement_alg : default_algs,
+				memsize_arg ? (unsigned)strtoul(memsize_arg, NULL, 10) : 0);
+	}
+	if (huge_threshold && !pagetable_radix) {
+		fprintf(stderr, "Error: --huge needs the radix page table (-P radix)\n");
+		exit(1);
+	}
+	if (replacement_alg == NULL ||
+	    (memsize_arg == NULL && resume_file == NULL)) {
+		fprintf(stderr, "%s", usage);
+		exit(1);
+	}
+	if (stats_file != NULL && (sweep || shards > 1)) {
+		fprintf(stderr, "Error: --stats cannot be used with --sweep or -j\n");
+		exit(1);
+	}
+	if (interval_refs && (sweep || shards > 1)) {
+		fprintf(stderr, "Error: --interval cannot be used with --sweep or -j\n");
+		exit(1);
+	}
+	if (sweep) {
+		return run_sweep(replacement_alg, memsize_arg, swapsize);
+	}
+	if (stats_file != NULL) {
+		stats_init();
+	}
+	if (resume_file == NULL) {
+		memsize = (unsigned)strtoul(memsize_arg, NULL, 10);
 	}
-
-	// Initialize main data structures for simulation.
-	// This happens before calling the replacement algorithm init function
-	// so that the init_fcn can refer to the coremap if needed.
-	coremap = calloc(memsize, sizeof(struct frame));
-	physmem = malloc(memsize * SIMPAGESIZE);
-	swap_init(swapsize);
-	init_pagetable();
 
 	// Initialize replacement algorithm functions.
-	if(replacement_alg == NULL) {
-		fprintf(stderr, "%s", usage);
+	if(select_algorithm(replacement_alg) != 0) {
+		fprintf(stderr, "Error: invalid replacement algorithm - %s\n", 
+				replacement_alg);
 		exit(1);
-	} else {
-		int i;
-		for (i = 0; i < num_algs; i++) {
-			if(strcmp(algs[i].name, replacement_alg) == 0) {
-				init_fcn = algs[i].init;
-				ref_fcn = algs[i].ref;
-				evict_fcn = algs[i].evict;
-				break;
-			}
-		}
-		if(evict_fcn == NULL) {
-			fprintf(stderr, "Error: invalid replacement algorithm - %s\n", 
+	}
+	if ((checkpoint_every || resume_file) &&
+	    (save_fcn == NULL || load_fcn == NULL)) {
+		fprintf(stderr, "Error: %s does not support checkpoints\n",
+				replacement_alg);
+		exit(1);
+	}
+	if (replace_local && evict_local_fcn == NULL) {
+		fprintf(stderr, "Error: %s does not support local replacement\n",
+				replacement_alg);
+		exit(1);
+	}
+	if (shards > 1) {
+		// OPT and wopt look ahead in the whole trace, not the shard's part
+		if (init_fcn == opt_init || init_fcn == wopt_init) {
+			fprintf(stderr, "Error: %s cannot be used with -j\n",
 					replacement_alg);
 			exit(1);
 		}
+		return run_sharded(memsize, swapsize, shards);
 	}
+
+	if (prefetcher != NULL) {
+		prefetch_baseline_start(swapsize);
+	}
+
+	// Text or binary format is detected from the file contents
+	tr = trace_open(tracefile);
+
+	init_simulation(swapsize);
+	if (prefetcher != NULL) {
+		prefetch_init();
+	}
+	if (interval_refs) {
+		interval_open(interval_file, swapsize);
+	}
+
 	// Call replacement algorithm's init_fcn before replaying trace.
+	STATS_START(PHASE_POLICY_INIT);
 	init_fcn();
+	STATS_STOP(PHASE_POLICY_INIT);
+	if (resume_file != NULL) {
+		resume_restore(tr);
+	}
 
-	replay_trace(tfp);
+	STATS_START(PHASE_REPLAY);
+	replay_trace(tr);
+	STATS_STOP(PHASE_REPLAY);
+	if (checkpoint_every) {
+		checkpoint_finish();
+	}
+	trace_close(tr);
+	if (interval_refs) {
+		interval_close();
+	}
 	print_pagedirectory();
+	pagetable_report();
+	tlb_report();
+	huge_report();
+	process_report();
+	if (prefetcher != NULL) {
+		prefetch_report();
+	}
+	if (cleaner_low) {
+		cleaner_report();
+	}
+	checkpoint_report();
 
 	// Cleanup - removes temporary swapfile.
 	swap_destroy();
+	swap_report();
+
+	if (report_fcn != NULL) {
+		report_fcn();
+	}
 
 	printf("\n");
-	printf("Hit count: %d\n", hit_count);
-	printf("Miss count: %d\n", miss_count);
-	printf("Clean evictions: %d\n",evict_clean_count);
-	printf("Dirty evictions: %d\n",evict_dirty_count); 
-	printf("Total references : %d\n", ref_count);
+	printf("Hit count: %lu\n", hit_count);
+	printf("Miss count: %lu\n", miss_count);
+	printf("Clean evictions: %lu\n",evict_clean_count);
+	printf("Dirty evictions: %lu\n",evict_dirty_count); 
+	printf("Total references : %lu\n", ref_count);
 	printf("Hit rate: %.4f\n", (double)hit_count/ref_count * 100);
 	printf("Miss rate: %.4f\n", (double)miss_count/ref_count *100);
+
+	if (stats_file != NULL) {
+		if (strcmp(stats_file, "-") == 0) {
+			stats_fp = stdout;
+		} else if ((stats_fp = fopen(stats_file, "w")) == NULL) {
+			perror("Error opening stats file:");
+			exit(1);
+		}
+		stats_write(stats_fp, replacement_alg);
+		if (stats_fp != stdout && fclose(stats_fp) != 0) {
+			perror("Error writing stats file:");
+			exit(1);
+		}
+	}
 		
 	return(0);
 }
@@ -2,17 +2,18 @@
 #define __SIM_H__
 
 #include "pagetable.h"
+#include "trace.h"
 #define MAXLINE 256
 #define SIMPAGESIZE 16  /* Simulated physical memory page frame size */
 
 extern unsigned memsize;
 extern int debug;
 
-extern int hit_count;
-extern int miss_count;
-extern int ref_count;
-extern int evict_clean_count;
-extern int evict_dirty_count;
+extern unsigned long hit_count;
+extern unsigned long miss_count;
+extern unsigned long ref_count;
+extern unsigned long evict_clean_count;
+extern unsigned long evict_dirty_count;
 
 /* We simulate physical memory with a large array of bytes */
 extern char *physmem;
@@ -23,17 +24,71 @@ extern char *physmem;
  */
 extern char *tracefile;
 
+/* When the trace has been loaded into memory (e.g. for a sweep), these
+ * hold the packed references and anything that needs to read the trace
+ * uses them instead of parsing the file again.
+ */
+extern trace_ref_t *trace_buffer;
+extern uint64_t trace_buffer_len;
+
+// Lookahead window (in references) for the streaming OPT algorithm, and
+// whether to compare its result with exact OPT.
+extern unsigned long opt_window;
+extern int opt_compare;
+
+// Working set window (tau) for ws, and the fault interval above which pff
+// shrinks the resident set, both in references of the process
+extern unsigned long ws_tau;
+extern unsigned long pff_threshold;
+
+// Name of the swap backend that moves pages to and from the swapfile
+extern char *swap_backend;
+extern int swap_verbose;
+
 // Each eviction algorithm is represented by a structure with its name
-// and three functions.
+// and three functions, plus optional hooks.
 struct functions {
 	char *name;                  // String name of eviction algorithm
 	void (*init)(void);          // Initialize any data needed by alg
 	void (*ref)(pgtbl_entry_t *);    // Called on each reference
 	int (*evict)();              // Called to choose victim for eviction
+	void (*report)(void);        // Optional: print extra results at exit
+	void (*on_fault)(pgtbl_entry_t *);   // Optional: page missed
+	void (*on_evict)(int, pgtbl_entry_t *); // Optional: page left frame
+	void (*fill)(pgtbl_entry_t *);   // Optional: page brought in without
+	                                 // being referenced (default: ref)
+	int (*evict_local)(int);     // Optional: choose a victim among the
+	                             // pages of the given process
+	void (*save)(FILE *);        // Optional: write the algorithm's state
+	void (*load)(FILE *);        // to a checkpoint, and read it back
 };
 
 extern void (*init_fcn)();
 extern void (*ref_fcn)(pgtbl_entry_t *);
 extern int (*evict_fcn)();
+extern void (*report_fcn)(void);
+extern void (*on_fault_fcn)(pgtbl_entry_t *);
+extern void (*on_evict_fcn)(int, pgtbl_entry_t *);
+extern void (*fill_fcn)(pgtbl_entry_t *);
+extern int (*evict_local_fcn)(int);
+extern void (*save_fcn)(FILE *);
+extern void (*load_fcn)(FILE *);
+
+extern struct functions *algs;
+extern const char *algorithm_name;
+extern int num_algs;
+extern void register_algorithm(const struct functions *f);
+extern void register_builtin_algorithms(void);
+
+extern struct trace *sim_trace_open(void);
+extern void access_mem(char type, addr_t vaddr);
+extern void replay_trace(struct trace *tr);
+extern int select_algorithm(const char *name);
+extern void init_simulation(unsigned swapsize);
+extern int run_sweep(char *alg_list, char *memsize_list, unsigned swapsize);
+extern int run_curve(char *alg_list, unsigned maxsize);
+extern int run_sharded(unsigned total_memsize, unsigned swapsize, int nshards);
+extern uint64_t opt_exact_misses(const trace_ref_t *refs, uint64_t n,
+		unsigned m);
 
 #endif // __SIM_H 
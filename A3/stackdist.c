@@ -0,0 +1,427 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "sim.h"
+#include "pagemap.h"
+
+/* Miss-ratio curves from stack distances (Mattson et al., 1970).
+ *
+ * LRU and OPT are both stack algorithms: the pages resident in a memory
+ * of m frames are always the top m entries of one priority stack. So the
+ * depth of each referenced page in that stack (its stack distance) says
+ * whether the reference hits for every memory size at once: it hits
+ * exactly when the distance is at most m. One pass over the trace then
+ * gives the miss count for every memsize from 1 to N.
+ */
+
+/* Histogram of stack distances. hist[d] counts references found at depth
+ * d. References that miss for every memory size being tracked (including
+ * the first reference to each page) are counted separately in cold.
+ */
+struct curve {
+	uint64_t *hist;
+	uint64_t len;        // Number of entries allocated in hist
+	uint64_t cold;
+	uint64_t refs;
+};
+
+static void curve_add(struct curve *c, uint64_t dist) {
+	if (dist >= c->len) {
+		uint64_t newlen = c->len ? c->len : 1024;
+		while (newlen <= dist) {
+			newlen *= 2;
+		}
+		c->hist = realloc(c->hist, newlen * sizeof(uint64_t));
+		if (c->hist == NULL) {
+			perror("Failed to allocate stack distance histogram");
+			exit(1);
+		}
+		memset(c->hist + c->len, 0, (newlen - c->len) * sizeof(uint64_t));
+		c->len = newlen;
+	}
+	c->hist[dist]++;
+}
+
+//---------------------------------------------------------------------
+// LRU: the stack distance of a reference is the number of distinct pages
+// touched since the previous reference to the same page. We keep a
+// Fenwick tree over time in which only the most recent access to each
+// page is marked, so that count is a range sum taking O(log n).
+//
+// The tree is indexed by time, and text traces do not say how long they
+// are, so when time runs past the end of the tree the live marks (one per
+// distinct page) are renumbered 1..D and a fresh tree is built.
+
+struct fenwick {
+	long *tree;
+	uint64_t cap;
+};
+
+static inline void fenwick_add(struct fenwick *f, uint64_t i, long v) {
+	for (; i <= f->cap; i += i & -i) {
+		f->tree[i] += v;
+	}
+}
+
+static inline long fenwick_sum(struct fenwick *f, uint64_t i) {
+	long s = 0;
+	for (; i > 0; i -= i & -i) {
+		s += f->tree[i];
+	}
+	return s;
+}
+
+/* Builds a tree of 'cap' entries with the first 'ones' entries marked. */
+static void fenwick_init(struct fenwick *f, uint64_t cap, uint64_t ones) {
+	uint64_t i;
+
+	free(f->tree);
+	f->cap = cap;
+	f->tree = calloc(cap + 1, sizeof(long));
+	if (f->tree == NULL) {
+		perror("Failed to allocate stack distance tree");
+		exit(1);
+	}
+	// Linear-time construction: push each node's sum up to its parent
+	for (i = 1; i <= cap; i++) {
+		uint64_t parent = i + (i & -i);
+		if (i <= ones) {
+			f->tree[i] += 1;
+		}
+		if (parent <= cap) {
+			f->tree[parent] += f->tree[i];
+		}
+	}
+}
+
+static int cmp_time(const void *a, const void *b) {
+	long x = **(long * const *)a, y = **(long * const *)b;
+	return (x > y) - (x < y);
+}
+
+/* Renumbers every page's last access time to 1..D, keeping their order,
+ * and rebuilds the tree. Returns the new current time, D.
+ */
+static uint64_t lru_compact(struct fenwick *f, struct pagemap *last) {
+	long **slots = malloc(last->size * sizeof(long *));
+	uint64_t i, n = 0;
+
+	for (i = 0; i < last->cap; i++) {
+		if (last->keys[i] != PAGEMAP_EMPTY) {
+			slots[n++] = &last->vals[i];
+		}
+	}
+	qsort(slots, n, sizeof(long *), cmp_time);
+	for (i = 0; i < n; i++) {
+		*slots[i] = (long)(i + 1);
+	}
+	free(slots);
+	fenwick_init(f, 4 * n > 65536 ? 4 * n : 65536, n);
+	return n;
+}
+
+static void lru_curve(struct curve *c) {
+	struct trace *tr = sim_trace_open();
+	struct pagemap *last = pagemap_create(0);
+	struct fenwick f = {NULL, 0};
+	uint64_t t = 0;
+	char type;
+	addr_t vaddr;
+
+	fenwick_init(&f, 65536, 0);
+	while (trace_next(tr, &type, &vaddr)) {
+		unsigned long page = TRACE_PAGE(tr->pid, vaddr);
+		long *slot;
+
+		if (++t > f.cap) {
+			t = lru_compact(&f, last) + 1;
+		}
+		c->refs++;
+		if ((slot = pagemap_lookup(last, page)) != NULL) {
+			// Distinct pages since the last access, plus this one
+			uint64_t l = (uint64_t)*slot;
+			curve_add(c, fenwick_sum(&f, t - 1) - fenwick_sum(&f, l) + 1);
+			fenwick_add(&f, l, -1);
+			*slot = (long)t;
+		} else {
+			c->cold++;
+			pagemap_insert(last, page, (long)t);
+		}
+		fenwick_add(&f, t, 1);
+	}
+	trace_close(tr);
+	pagemap_destroy(last);
+	free(f.tree);
+}
+
+//---------------------------------------------------------------------
+// OPT: the priority of a page is the time of its next reference, sooner
+// being higher. On a reference to x at depth d, x moves to the top and
+// the page it displaced is carried down: at each depth i < d the carried
+// page and the page at i are compared, and the one referenced later is
+// carried further. The carried page finally fills the hole at depth d.
+//
+// The pages below depth N never affect the top N, so the stack is cut off
+// at the largest memory size of interest. Each reference then costs
+// O(min(d, N)).
+
+static void opt_curve(struct curve *c, uint64_t maxsize) {
+	uint64_t n, i, npages;
+	trace_ref_t *refs;
+	uint64_t *next_use;
+	unsigned long *stack;  // Page at each depth, top of stack first
+	uint64_t *prio;        // Next reference time of the page at each depth
+	uint64_t depth = 0;    // Entries currently in the (truncated) stack
+
+	if (trace_buffer != NULL) {
+		refs = trace_buffer;
+		n = trace_buffer_len;
+	} else {
+		refs = trace_load(tracefile, &n);
+	}
+	next_use = trace_next_use(refs, n, &npages);
+	if (maxsize == 0 || maxsize > npages) {
+		maxsize = npages;
+	}
+	stack = malloc((maxsize + 1) * sizeof(unsigned long));
+	prio = malloc((maxsize + 1) * sizeof(uint64_t));
+	if (stack == NULL || prio == NULL) {
+		perror("Failed to allocate OPT stack");
+		exit(1);
+	}
+
+	for (i = 0; i < n; i++) {
+		unsigned long page = TRACE_REF_PAGE(refs[i]);
+		unsigned long carry;
+		uint64_t carry_prio, d, j;
+
+		c->refs++;
+		for (d = 0; d < depth && stack[d] != page; d++) {
+		}
+		if (d < depth) {
+			curve_add(c, d + 1);
+		} else {
+			// Not in the top maxsize: a miss for every size we report
+			c->cold++;
+			if (depth < maxsize) {
+				depth++;
+			}
+		}
+		if (d == 0) {
+			stack[0] = page;
+			prio[0] = next_use[i];
+			continue;
+		}
+
+		carry = stack[0];
+		carry_prio = prio[0];
+		stack[0] = page;
+		prio[0] = next_use[i];
+		for (j = 1; j < d && j < depth; j++) {
+			// Keep whichever of the two is referenced sooner at depth j
+			if (prio[j] > carry_prio) {
+				unsigned long tp = stack[j];
+				uint64_t tprio = prio[j];
+				stack[j] = carry;
+				prio[j] = carry_prio;
+				carry = tp;
+				carry_prio = tprio;
+			}
+		}
+		// The carried page fills the hole x left, or drops out of the
+		// top maxsize if x came from below it
+		if (j < depth) {
+			stack[j] = carry;
+			prio[j] = carry_prio;
+		}
+	}
+
+	free(stack);
+	free(prio);
+	free(next_use);
+	if (refs != trace_buffer) {
+		free(refs);
+	}
+}
+
+/* Exact OPT miss count for a single memory size, for checking windowed
+ * or approximate variants against. Resident pages live in a map from page
+ * to next use, and a max-heap holds (next use, page) pairs. Hits push a new
+ * pair instead of updating the old one in place; stale pairs are skipped
+ * when they reach the top, and the heap is rebuilt from the map whenever
+ * it grows well past m entries. O(n log m) time.
+ */
+struct opt_entry {
+	uint64_t next;
+	unsigned long page;
+};
+
+static void entry_push(struct opt_entry *h, uint64_t *size, struct opt_entry e) {
+	uint64_t i = (*size)++;
+	while (i > 0 && h[(i - 1) / 2].next < e.next) {
+		h[i] = h[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	h[i] = e;
+}
+
+static struct opt_entry entry_pop(struct opt_entry *h, uint64_t *size) {
+	struct opt_entry top = h[0], last = h[--(*size)];
+	uint64_t i = 0, child;
+
+	while ((child = 2 * i + 1) < *size) {
+		if (child + 1 < *size && h[child + 1].next > h[child].next) {
+			child++;
+		}
+		if (h[child].next <= last.next) {
+			break;
+		}
+		h[i] = h[child];
+		i = child;
+	}
+	h[i] = last;
+	return top;
+}
+
+uint64_t opt_exact_misses(const trace_ref_t *refs, uint64_t n, unsigned m) {
+	uint64_t *next_use = trace_next_use(refs, n, NULL);
+	struct pagemap *res = pagemap_create(m);
+	uint64_t cap = 4 * (uint64_t)m + 64;
+	struct opt_entry *heap = malloc((cap + 1) * sizeof(struct opt_entry));
+	uint64_t size = 0, misses = 0, i, j;
+
+	if (heap == NULL) {
+		perror("Failed to allocate OPT heap");
+		exit(1);
+	}
+	for (i = 0; i < n; i++) {
+		struct opt_entry e;
+		long *slot;
+
+		e.page = TRACE_REF_PAGE(refs[i]);
+		e.next = next_use[i];
+		if ((slot = pagemap_lookup(res, e.page)) == NULL) {
+			misses++;
+			while (res->size >= m) {
+				struct opt_entry v = entry_pop(heap, &size);
+				long *vslot = pagemap_lookup(res, v.page);
+				if (vslot != NULL && (uint64_t)*vslot == v.next) {
+					pagemap_remove(res, v.page);
+				}
+			}
+			pagemap_insert(res, e.page, (long)e.next);
+		} else {
+			*slot = (long)e.next;
+		}
+
+		if (size == cap) {
+			// Drop the stale entries by rebuilding from the map
+			size = 0;
+			for (j = 0; j < res->cap; j++) {
+				if (res->keys[j] != PAGEMAP_EMPTY) {
+					struct opt_entry live;
+					live.page = res->keys[j];
+					live.next = (uint64_t)res->vals[j];
+					if (live.page != e.page) {
+						entry_push(heap, &size, live);
+					}
+				}
+			}
+		}
+		entry_push(heap, &size, e);
+	}
+	free(heap);
+	free(next_use);
+	pagemap_destroy(res);
+	return misses;
+}
+
+/* Number of misses with m frames for the curve. */
+static uint64_t curve_misses(struct curve *c, uint64_t m) {
+	uint64_t misses = c->cold;
+	uint64_t d;
+
+	for (d = m + 1; d < c->len; d++) {
+		misses += c->hist[d];
+	}
+	return misses;
+}
+
+/* Prints the miss-ratio curves of the algorithms in the comma-separated
+ * alg_list ("lru", "opt" or both) for every memory size from 1 to maxsize,
+ * or up to the number of distinct pages in the trace if maxsize is 0.
+ * Returns the exit status for sim.
+ */
+int run_curve(char *alg_list, unsigned maxsize) {
+	struct curve lru = {NULL, 0, 0, 0}, opt = {NULL, 0, 0, 0};
+	int do_lru = 0, do_opt = 0;
+	uint64_t m, npages, lru_miss, opt_miss;
+	char *tok;
+
+	for (tok = strtok(alg_list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+		if (strcmp(tok, "lru") == 0) {
+			do_lru = 1;
+		} else if (strcmp(tok, "opt") == 0) {
+			do_opt = 1;
+		} else {
+			fprintf(stderr, "Error: no miss-ratio curve for algorithm - %s\n",
+					tok);
+			return 1;
+		}
+	}
+	// OPT needs the whole trace for next-use times, so load it once and
+	// let the LRU pass replay the same buffer
+	if (do_opt && trace_buffer == NULL) {
+		trace_buffer = trace_load(tracefile, &trace_buffer_len);
+	}
+	if (do_lru) {
+		lru_curve(&lru);
+	}
+	if (do_opt) {
+		opt_curve(&opt, maxsize);
+	}
+
+	// Every distinct page is a cold miss, so this is the size at which
+	// both curves have flattened out
+	npages = do_lru ? lru.cold : opt.cold;
+	if (maxsize == 0 || maxsize > npages) {
+		maxsize = npages;
+	}
+
+	printf("Memory size");
+	if (do_lru) {
+		printf(",LRU misses,LRU miss rate");
+	}
+	if (do_opt) {
+		printf(",OPT misses,OPT miss rate");
+	}
+	printf("\n");
+
+	// Walk sizes upwards, removing each depth's hits from the running
+	// miss count instead of re-summing the histogram every time
+	lru_miss = do_lru ? curve_misses(&lru, 0) : 0;
+	opt_miss = do_opt ? curve_misses(&opt, 0) : 0;
+	for (m = 1; m <= maxsize; m++) {
+		printf("%lu", m);
+		if (do_lru) {
+			if (m < lru.len) {
+				lru_miss -= lru.hist[m];
+			}
+			printf(",%lu,%.4f", lru_miss,
+			       (double)lru_miss/lru.refs * 100);
+		}
+		if (do_opt) {
+			if (m < opt.len) {
+				opt_miss -= opt.hist[m];
+			}
+			printf(",%lu,%.4f", opt_miss,
+			       (double)opt_miss/opt.refs * 100);
+		}
+		printf("\n");
+	}
+
+	free(lru.hist);
+	free(opt.hist);
+	return 0;
+}
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "sim.h"
+#include "stats.h"
+
+/* Per-phase instrumentation for --stats, written out as JSON.
+ *
+ * Wall-clock time is taken from CLOCK_MONOTONIC at every start and stop.
+ * The hardware counters are one perf_event_open group, read with a single
+ * read() per start or stop. That is a system call, which would cost more
+ * than a page table walk, so for phases entered many times only one entry
+ * in STATS_SAMPLE is counted and the totals are scaled up by the number of
+ * entries. If the counters cannot be opened (no PMU, or not permitted)
+ * they are reported as null and only the times are given.
+ */
+
+#define STATS_SAMPLE 64
+
+enum { CTR_CYCLES, CTR_INSTRUCTIONS, CTR_LLC_MISSES, NUM_CTRS };
+
+static const char *phase_names[NUM_PHASES] = {
+	"parse", "policy_init", "replay", "walk", "evict", "swap"
+};
+static const char *ctr_names[NUM_CTRS] = {
+	"cycles", "instructions", "llc_misses"
+};
+
+struct phase {
+	double seconds;
+	unsigned long calls;
+	unsigned long sampled;        // Calls the counters were read for
+	uint64_t counts[NUM_CTRS];    // Summed over the sampled calls
+	struct timespec t0;
+	uint64_t c0[NUM_CTRS];
+	int sampling;                 // Counters were read at this start
+};
+
+int stats_enabled = 0;
+
+static struct phase phases[NUM_PHASES];
+static struct timespec start_time;
+static int perf_fd = -1;              // Group leader, or -1
+static int ctr_slot[NUM_CTRS];        // Position in the group read, or -1
+static int num_open;
+
+static double elapsed(struct timespec *from, struct timespec *to) {
+	return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+/* Opens one counter in the group. Returns its fd, or -1. */
+static int open_counter(uint32_t type, uint64_t config, int group) {
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = 1;      // Allowed at perf_event_paranoid 2
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+/* Reads the counters into values, indexed by CTR_*. */
+static void read_counters(uint64_t *values) {
+	uint64_t buf[1 + NUM_CTRS];
+	int i;
+
+	if (read(perf_fd, buf, sizeof(buf)) < (ssize_t)sizeof(uint64_t)) {
+		memset(values, 0, NUM_CTRS * sizeof(uint64_t));
+		return;
+	}
+	for (i = 0; i < NUM_CTRS; i++) {
+		values[i] = ctr_slot[i] >= 0 ? buf[1 + ctr_slot[i]] : 0;
+	}
+}
+
+void stats_init() {
+	int fd;
+
+	stats_enabled = 1;
+	memset(phases, 0, sizeof(phases));
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+	ctr_slot[CTR_CYCLES] = ctr_slot[CTR_INSTRUCTIONS] = -1;
+	ctr_slot[CTR_LLC_MISSES] = -1;
+	num_open = 0;
+	perf_fd = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+	if (perf_fd == -1) {
+		return;
+	}
+	ctr_slot[CTR_CYCLES] = num_open++;
+	// The others are optional: a virtual PMU may not offer all of them
+	fd = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, perf_fd);
+	if (fd != -1) {
+		ctr_slot[CTR_INSTRUCTIONS] = num_open++;
+	}
+	fd = open_counter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+			  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), perf_fd);
+	if (fd != -1) {
+		ctr_slot[CTR_LLC_MISSES] = num_open++;
+	}
+}
+
+void stats_start(enum stats_phase phase) {
+	struct phase *p = &phases[phase];
+
+	p->sampling = perf_fd != -1 && p->calls % STATS_SAMPLE == 0;
+	p->calls++;
+	if (p->sampling) {
+		read_counters(p->c0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &p->t0);
+}
+
+void stats_stop(enum stats_phase phase) {
+	struct phase *p = &phases[phase];
+	struct timespec t1;
+	uint64_t c1[NUM_CTRS];
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	p->seconds += elapsed(&p->t0, &t1);
+	if (p->sampling) {
+		read_counters(c1);
+		for (i = 0; i < NUM_CTRS; i++) {
+			p->counts[i] += c1[i] - p->c0[i];
+		}
+		p->sampled++;
+	}
+}
+
+/* Writes s as a JSON string. */
+static void write_string(FILE *fp, const char *s) {
+	fputc('"', fp);
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\') {
+			fprintf(fp, "\\%c", *s);
+		} else if ((unsigned char)*s < 0x20) {
+			fprintf(fp, "\\u%04x", *s);
+		} else {
+			fputc(*s, fp);
+		}
+	}
+	fputc('"', fp);
+}
+
+/* Writes the results of the run as one JSON object. */
+void stats_write(FILE *fp, const char *alg) {
+	struct timespec now;
+	double replay = phases[PHASE_REPLAY].seconds;
+	int i, j;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	fprintf(fp, "{\n  \"trace\": ");
+	write_string(fp, tracefile != NULL ? tracefile : "-");
+	fprintf(fp, ",\n  \"algorithm\": ");
+	write_string(fp, alg);
+	fprintf(fp, ",\n  \"memsize\": %u,\n", memsize);
+	fprintf(fp, "  \"references\": %lu,\n", ref_count);
+	fprintf(fp, "  \"hits\": %lu,\n  \"misses\": %lu,\n", hit_count, miss_count);
+	fprintf(fp, "  \"clean_evictions\": %lu,\n  \"dirty_evictions\": %lu,\n",
+		evict_clean_count, evict_dirty_count);
+	fprintf(fp, "  \"wall_seconds\": %.6f,\n", elapsed(&start_time, &now));
+	fprintf(fp, "  \"refs_per_second\": %.1f,\n",
+		replay > 0 ? ref_count / replay : 0.0);
+	fprintf(fp, "  \"perf_counters\": %s,\n", perf_fd != -1 ? "true" : "false");
+	fprintf(fp, "  \"phases\": {\n");
+	for (i = 0; i < NUM_PHASES; i++) {
+		struct phase *p = &phases[i];
+
+		fprintf(fp, "    \"%s\": {\"seconds\": %.6f, \"calls\": %lu",
+			phase_names[i], p->seconds, p->calls);
+		for (j = 0; j < NUM_CTRS; j++) {
+			if (ctr_slot[j] < 0) {
+				fprintf(fp, ", \"%s\": null", ctr_names[j]);
+			} else {
+				// Scale the sampled calls up to all of them
+				fprintf(fp, ", \"%s\": %.0f", ctr_names[j], p->sampled ?
+					(double)p->counts[j] * p->calls / p->sampled : 0.0);
+			}
+		}
+		fprintf(fp, "}%s\n", i < NUM_PHASES - 1 ? "," : "");
+	}
+	fprintf(fp, "  }\n}\n");
+}
@@ -0,0 +1,32 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdio.h>
+
+/* Per-phase timing for --stats. Each phase adds up the wall-clock time
+ * between STATS_START and STATS_STOP, and where perf_event_open works,
+ * the cycles, instructions and last-level cache misses too. Phases may
+ * nest (the walk happens during replay), but a phase may not nest in
+ * itself. The macros cost one branch when --stats is off.
+ */
+enum stats_phase {
+	PHASE_PARSE,          // Reading and decoding the trace
+	PHASE_POLICY_INIT,    // The algorithm's init, e.g. OPT's next-use pass
+	PHASE_REPLAY,         // The whole replay, including the phases below
+	PHASE_WALK,           // Page table walks
+	PHASE_EVICT,          // Choosing victims (evict_fcn)
+	PHASE_SWAP,           // Swap I/O
+	NUM_PHASES
+};
+
+extern int stats_enabled;
+
+extern void stats_init(void);
+extern void stats_start(enum stats_phase phase);
+extern void stats_stop(enum stats_phase phase);
+extern void stats_write(FILE *fp, const char *alg);
+
+#define STATS_START(phase) do { if (stats_enabled) stats_start(phase); } while (0)
+#define STATS_STOP(phase)  do { if (stats_enabled) stats_stop(phase); } while (0)
+
+#endif /* __STATS_H__ */
@@ -5,8 +5,12 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
 #include "pagetable.h"
 #include "sim.h"
+#include "pagemap.h"
+#include "checkpoint.h"
 
 //---------------------------------------------------------------------
 // Bitmap definitions and functions to manage space in swapfile.
@@ -14,6 +18,11 @@
 // on demand with a little effort.
 //
 // The bitmap code is modified from the OS/161 bitmap functions.
+// Allocation is next-fit: it carries on from the word where the last
+// free bit was found, and finds free bits a word at a time. A summary
+// bitmap with one bit per word, set when the word is full, lets it skip
+// 32 full words at a time, so allocating stays cheap even when the swap
+// is large and mostly full.
 
 #define BITS_PER_WORD 32 // Assumes sizeof(unsigned) = 4 bytes, 32 bits
 #define WORD_ALLBITS    (0xffffffff)
@@ -23,31 +32,64 @@
 struct bitmap {
         unsigned nbits;
         unsigned *v;
+        unsigned nwords;
+        unsigned *full;         /* Summary: bit i set if v[i] is full */
+        unsigned hint;          /* Word to start the next search at */
 };
 
+static
+inline
+void
+bitmap_translate(unsigned bitno, unsigned *ix, unsigned *mask)
+{
+        unsigned offset;
+        *ix = bitno / BITS_PER_WORD;
+        offset = bitno % BITS_PER_WORD;
+        *mask = ((unsigned)1) << offset;
+}
+
+/* Brings the summary bit for word ix up to date. */
+static
+void
+bitmap_summarize(struct bitmap *b, unsigned ix)
+{
+        unsigned six, mask;
+
+        bitmap_translate(ix, &six, &mask);
+        if (b->v[ix] == WORD_ALLBITS) {
+                b->full[six] |= mask;
+        } else {
+                b->full[six] &= ~mask;
+        }
+}
+
 struct bitmap *
 bitmap_create(unsigned nbits)
 {
         struct bitmap *b; 
-        unsigned words;
+        unsigned words, swords, j;
 
         words = DIVROUNDUP(nbits, BITS_PER_WORD);
+        swords = DIVROUNDUP(words, BITS_PER_WORD);
         b = (struct bitmap *)malloc(sizeof(struct bitmap));
         if (b == NULL) {
                 return NULL;
         }
-        b->v = malloc(words*sizeof(unsigned));
-        if (b->v == NULL) {
+        b->v = calloc(words, sizeof(unsigned));
+        b->full = calloc(swords, sizeof(unsigned));
+        if (b->v == NULL || b->full == NULL) {
+                free(b->v);
+                free(b->full);
                 free(b);
                 return NULL;
         }
-
-        memset(b->v, 0, words*sizeof(unsigned));
         b->nbits = nbits;
+        b->nwords = words;
+        b->hint = 0;
 
         /* Mark any leftover bits at the end in use */
         if (words > nbits / BITS_PER_WORD) {
-                unsigned j, ix = words-1;
+                unsigned ix = words-1;
                 unsigned overbits = nbits - ix*BITS_PER_WORD;
 
                 assert(nbits / BITS_PER_WORD == words-1);
@@ -58,43 +100,60 @@ bitmap_create(unsigned nbits)
                 }
         }
 
+        /* Likewise, summary bits past the last word count as full */
+        for (j = words; j < swords*BITS_PER_WORD; j++) {
+                b->full[j / BITS_PER_WORD] |= ((unsigned)1 << (j % BITS_PER_WORD));
+        }
+
         return b;
 }
 
+/* Returns the first word at or after word 'from' that is not full, or
+ * nwords if there is none.
+ */
+static
+unsigned
+bitmap_find_word(struct bitmap *b, unsigned from)
+{
+        unsigned six = from / BITS_PER_WORD;
+        unsigned swords = DIVROUNDUP(b->nwords, BITS_PER_WORD);
+        unsigned avail;
+
+        if (from >= b->nwords) {
+                return b->nwords;
+        }
+        avail = ~b->full[six] & (WORD_ALLBITS << (from % BITS_PER_WORD));
+        while (avail == 0) {
+                if (++six == swords) {
+                        return b->nwords;
+                }
+                avail = ~b->full[six];
+        }
+        return six*BITS_PER_WORD + __builtin_ctz(avail);
+}
+
 int
 bitmap_alloc(struct bitmap *b, unsigned *index)
 {
         unsigned ix;
-        unsigned maxix = DIVROUNDUP(b->nbits, BITS_PER_WORD);
         unsigned offset;
 
-        for (ix=0; ix<maxix; ix++) {
-                if (b->v[ix]!=WORD_ALLBITS) {
-                        for (offset = 0; offset < BITS_PER_WORD; offset++) {
-                                unsigned mask = ((unsigned)1) << offset;
-
-                                if ((b->v[ix] & mask)==0) {
-                                        b->v[ix] |= mask;
-                                        *index = (ix*BITS_PER_WORD)+offset;
-                                        assert(*index < b->nbits);
-                                        return 0;
-                                }
-                        }
-                        assert(0);
+        ix = bitmap_find_word(b, b->hint);
+        if (ix == b->nwords) {
+                /* Wrap around to the start */
+                ix = bitmap_find_word(b, 0);
+                if (ix == b->nwords) {
+                        return 1;
                 }
         }
-        return 1;
-}
 
-static
-inline
-void
-bitmap_translate(unsigned bitno, unsigned *ix, unsigned *mask)
-{
-        unsigned offset;
-        *ix = bitno / BITS_PER_WORD;
-        offset = bitno % BITS_PER_WORD;
-        *mask = ((unsigned)1) << offset;
+        offset = __builtin_ctz(~b->v[ix]);
+        b->v[ix] |= ((unsigned)1) << offset;
+        bitmap_summarize(b, ix);
+        b->hint = ix;
+        *index = (ix*BITS_PER_WORD)+offset;
+        assert(*index < b->nbits);
+        return 0;
 }
 
 void
@@ -108,6 +167,7 @@ bitmap_mark(struct bitmap *b, unsigned index)
 
         assert((b->v[ix] & mask)==0);
         b->v[ix] |= mask;
+        bitmap_summarize(b, ix);
 }
 
 void
@@ -121,6 +181,7 @@ bitmap_unmark(struct bitmap *b, unsigned index)
 
         assert((b->v[ix] & mask)!=0);
         b->v[ix] &= ~mask;
+        bitmap_summarize(b, ix);
 }
 
 
@@ -138,18 +199,303 @@ void
 bitmap_destroy(struct bitmap *b)
 {
         free(b->v);
+        free(b->full);
         free(b);
 }
 
 //---------------------------------------------------------------------
 // Swap definitions and functions.
+//
+// Page data can be moved to and from the swapfile by one of several
+// backends, chosen with -S:
+//   file  - an lseek and a read or write for every page;
+//   batch - (the default) dirty pages are collected in a write-back buffer
+//           and written out SWAP_BATCH at a time with pwritev. A page that
+//           is read back while still in the buffer never touches the file;
+//   mmap  - the swapfile is sized for swapsize pages and mapped, and pages
+//           are copied to and from the mapping with no system calls.
+// Space in the swapfile is managed the same way whichever is used.
+
+struct swap_ops {
+	char *name;
+	void (*init)(unsigned swapsize);  // Called once the swapfile exists
+	int (*pagein)(unsigned frame, int swap_offset);
+	int (*pageout)(unsigned frame, int swap_offset);
+	void (*discard)(int swap_offset); // The slot's contents are stale
+	void (*destroy)(void);            // Write back anything pending
+};
+
+char *swap_backend = "batch";
+int swap_verbose = 0;    // Set by -S: print swap_report
+static struct swap_ops *swap;
 
 static int swapfd;
 static struct bitmap *swapmap;
 static char *fname;
 
+// System calls made to move page data, and the number the file backend
+// would have made (two per page) for the same pageins and pageouts.
+static unsigned long swap_syscalls = 0;
+static unsigned long swap_syscalls_per_page = 0;
+static unsigned long swap_buffer_reads = 0;
+
+// Swap slots in use now and at most, and how many were freed as stale.
+static unsigned swap_slots;
+static unsigned swap_used = 0;
+static unsigned swap_peak = 0;
+static unsigned long swap_freed = 0;
+
+// Read data into (simulated) physical memory 'frame' from 'swap_offset'
+// in swap file.
+// Input:  frame - the physical frame number (not byte offset) in physmem
+//         swap_offset - the byte position in the swap file.
+// Return: 0 on success, 
+//	   -errno on error or number of bytes read on partial read
+// 
+static int file_pagein(unsigned frame, int swap_offset) {
+	char *frame_ptr;
+	off_t pos;
+	ssize_t bytes_read;
+
+	// Get pointer to page data in (simulated) physical memory
+	frame_ptr = &physmem[frame * SIMPAGESIZE];
+
+	// Seek to position in swap file where this page was stored
+	swap_syscalls += 2;
+	pos = lseek(swapfd, swap_offset, SEEK_SET);
+	if (pos != swap_offset) {
+		assert(pos == (off_t)-1);
+		perror("swap_pagein: failed to set read position");
+		return -errno;
+	}
+
+	// Read page data from swapfile into memory
+	bytes_read = read(swapfd, frame_ptr, SIMPAGESIZE);
+	if (bytes_read != SIMPAGESIZE) {
+		fprintf(stderr,"swap_pagein: did not read whole page\n");
+		return bytes_read;
+	}
+	return 0;
+}
+
+// Write data from (simulated) physical memory 'frame' to 'swap_offset'
+// in swap file, which has already been allocated.
+// Return: the swap_offset on success, or INVALID_SWAP on failure
+static int file_pageout(unsigned frame, int swap_offset) {
+	char *frame_ptr;
+	off_t pos;
+	ssize_t bytes_written;
+
+	// Get pointer to page data in (simulated) physical memory
+	frame_ptr = &physmem[frame * SIMPAGESIZE];
+
+	// Seek to position in swap file where this page will be stored
+	swap_syscalls += 2;
+	pos = lseek(swapfd, swap_offset, SEEK_SET);
+	if (pos != swap_offset) {
+		assert(pos == (off_t)-1);
+		perror("swap_pageout: failed to set write position");
+		return INVALID_SWAP;
+	}
+
+	// Read page data from swapfile into memory
+	bytes_written = write(swapfd, frame_ptr, SIMPAGESIZE);
+	if (bytes_written != SIMPAGESIZE) {
+		fprintf(stderr,"swap_pageout: did not write whole page\n");
+		return INVALID_SWAP;
+	}
+	return swap_offset;
+}
+
+static void file_init(unsigned swapsize) {
+}
+
+static void file_discard(int swap_offset) {
+}
+
+static void file_destroy() {
+}
+
+//---------------------------------------------------------------------
+// Write-back buffer for the batch backend.
+//
+// A buffered page is kept in the slot it was first given until the buffer
+// is flushed, so writing the same page out twice only updates the slot.
+// A flush sorts the slots by swap offset and writes each run of adjacent
+// pages with a single pwritev.
+
+#define SWAP_BATCH 256
+
+static char wb_data[SWAP_BATCH][SIMPAGESIZE];
+static int wb_off[SWAP_BATCH];
+static int wb_count = 0;
+static struct pagemap *wb_index;   // Swap offset -> slot in the buffer
+
+static int compare_wb_slots(const void *a, const void *b) {
+	return wb_off[*(const int *)a] - wb_off[*(const int *)b];
+}
+
+static void batch_flush() {
+	int order[SWAP_BATCH];
+	struct iovec iov[SWAP_BATCH];
+	int i, start;
+
+	for (i = 0; i < wb_count; i++) {
+		order[i] = i;
+	}
+	qsort(order, wb_count, sizeof(int), compare_wb_slots);
+
+	for (start = 0; start < wb_count; start = i) {
+		ssize_t len = SIMPAGESIZE;
+
+		iov[0].iov_base = wb_data[order[start]];
+		iov[0].iov_len = SIMPAGESIZE;
+		for (i = start + 1; i < wb_count &&
+		     wb_off[order[i]] == wb_off[order[i-1]] + SIMPAGESIZE; i++) {
+			iov[i - start].iov_base = wb_data[order[i]];
+			iov[i - start].iov_len = SIMPAGESIZE;
+			len += SIMPAGESIZE;
+		}
+		swap_syscalls++;
+		if (pwritev(swapfd, iov, i - start, wb_off[order[start]]) != len) {
+			perror("swap: failed to write back buffered pages");
+			exit(1);
+		}
+	}
+	wb_count = 0;
+	pagemap_clear(wb_index);
+}
+
+static void batch_init(unsigned swapsize) {
+	wb_count = 0;
+	wb_index = pagemap_create(SWAP_BATCH);
+}
+
+static void batch_destroy() {
+	// Write out anything still buffered, so the I/O counts are complete
+	batch_flush();
+	pagemap_destroy(wb_index);
+}
+
+static int batch_pagein(unsigned frame, int swap_offset) {
+	char *frame_ptr = &physmem[frame * SIMPAGESIZE];
+	long *slot = pagemap_lookup(wb_index, swap_offset);
+	ssize_t bytes_read;
+
+	if (slot != NULL) {
+		memcpy(frame_ptr, wb_data[*slot], SIMPAGESIZE);
+		swap_buffer_reads++;
+		return 0;
+	}
+	swap_syscalls++;
+	bytes_read = pread(swapfd, frame_ptr, SIMPAGESIZE, swap_offset);
+	if (bytes_read != SIMPAGESIZE) {
+		fprintf(stderr,"swap_pagein: did not read whole page\n");
+		return bytes_read < 0 ? -errno : bytes_read;
+	}
+	return 0;
+}
+
+static int batch_pageout(unsigned frame, int swap_offset) {
+	long *slot = pagemap_lookup(wb_index, swap_offset);
+
+	if (slot == NULL) {
+		if (wb_count == SWAP_BATCH) {
+			batch_flush();
+		}
+		wb_off[wb_count] = swap_offset;
+		slot = pagemap_insert(wb_index, swap_offset, wb_count++);
+	}
+	memcpy(wb_data[*slot], &physmem[frame * SIMPAGESIZE], SIMPAGESIZE);
+	return swap_offset;
+}
+
+/* Drops a buffered page whose slot has been freed, so that it is never
+ * written. The last buffered page moves into its place.
+ */
+static void batch_discard(int swap_offset) {
+	long *slot = pagemap_lookup(wb_index, swap_offset);
+	int i, last;
+
+	if (slot == NULL) {
+		return;
+	}
+	i = *slot;
+	last = --wb_count;
+	pagemap_remove(wb_index, swap_offset);
+	if (i != last) {
+		memcpy(wb_data[i], wb_data[last], SIMPAGESIZE);
+		wb_off[i] = wb_off[last];
+		*pagemap_lookup(wb_index, wb_off[i]) = i;
+	}
+}
+
+//---------------------------------------------------------------------
+// Memory-mapped swapfile for the mmap backend.
+
+static char *swap_mem;
+static size_t swap_mem_len;
+
+static void mmap_init(unsigned swapsize) {
+	swap_mem_len = (size_t)swapsize * SIMPAGESIZE;
+	if (ftruncate(swapfd, swap_mem_len) != 0) {
+		perror("Failed to size swapfile");
+		exit(1);
+	}
+	swap_mem = mmap(NULL, swap_mem_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+			swapfd, 0);
+	if (swap_mem == MAP_FAILED) {
+		perror("Failed to map swapfile");
+		exit(1);
+	}
+}
+
+static void mmap_destroy() {
+	munmap(swap_mem, swap_mem_len);
+}
+
+static int mmap_pagein(unsigned frame, int swap_offset) {
+	assert(swap_offset + SIMPAGESIZE <= swap_mem_len);
+	memcpy(&physmem[frame * SIMPAGESIZE], swap_mem + swap_offset,
+	       SIMPAGESIZE);
+	return 0;
+}
+
+static int mmap_pageout(unsigned frame, int swap_offset) {
+	assert(swap_offset + SIMPAGESIZE <= swap_mem_len);
+	memcpy(swap_mem + swap_offset, &physmem[frame * SIMPAGESIZE],
+	       SIMPAGESIZE);
+	return swap_offset;
+}
+
+static struct swap_ops swap_backends[] = {
+	{"file", file_init, file_pagein, file_pageout, file_discard,
+	 file_destroy},
+	{"batch", batch_init, batch_pagein, batch_pageout, batch_discard,
+	 batch_destroy},
+	{"mmap", mmap_init, mmap_pagein, mmap_pageout, file_discard,
+	 mmap_destroy},
+};
+
+/* Returns 0 if name is a swap backend, -1 otherwise. */
+int swap_select(const char *name) {
+	int i;
+	for (i = 0; i < sizeof(swap_backends) / sizeof(swap_backends[0]); i++) {
+		if (strcmp(swap_backends[i].name, name) == 0) {
+			swap = &swap_backends[i];
+			return 0;
+		}
+	}
+	return -1;
+}
+
 int swap_init(unsigned swapsize) {
 
+	if (swap_select(swap_backend) != 0) {
+		fprintf(stderr, "Error: invalid swap backend - %s\n", swap_backend);
+		exit(1);
+	}
+
 	// Initialize the swap file
 	fname = malloc(20);
 	strncpy(fname, "swapfile.XXXXXX",20);
@@ -163,12 +509,16 @@ int swap_init(unsigned swapsize) {
 		fprintf(stderr,"Failed to create bitmap for swap\n");
 		exit(1);
 	}
+	swap_slots = swapsize;
 
+	swap->init(swapsize);
 	return 0;
 }
 
 void swap_destroy() {
 
+	swap->destroy();
+
 	// Close and remove swapfile
 	close(swapfd);
 	unlink(fname);
@@ -178,6 +528,138 @@ void swap_destroy() {
 	return;
 }
 
+/* Prints how much I/O the swap backend did, compared with the file
+ * backend's two system calls per page.
+ */
+void swap_report() {
+	if (!swap_verbose) {
+		return;
+	}
+	printf("Swap backend: %s\n", swap->name);
+	printf("Swap syscalls: %lu (%lu with per-page I/O, %lu saved)\n",
+	       swap_syscalls, swap_syscalls_per_page,
+	       swap_syscalls_per_page - swap_syscalls);
+	printf("Swap slots: %u in use at exit, peak %u of %u, %lu freed as stale\n",
+	       swap_used, swap_peak, swap_slots, swap_freed);
+	if (swap_buffer_reads > 0) {
+		printf("Swap reads served from write-back buffer: %lu\n",
+		       swap_buffer_reads);
+	}
+}
+
+//---------------------------------------------------------------------
+// Saving and restoring the swap space in checkpoints.
+//
+// A checkpoint is written by a forked child while the simulation goes on,
+// but the swapfile (and the mmap backend's mapping) is shared with it, so
+// its contents are copied first with swap_snapshot. Everything else the
+// child needs is its own copy of this process's memory. The write-back
+// buffer is saved as it is, so the batch backend's I/O counts carry on
+// exactly as if the run had not been interrupted.
+
+// Returns a copy of the swapfile as the slots are now, to pass to
+// swap_save. The caller frees it.
+char *swap_snapshot() {
+	size_t len = (size_t)swap_slots * SIMPAGESIZE;
+	char *snap = calloc(len ? len : 1, 1);
+	ssize_t n;
+
+	if (snap == NULL) {
+		perror("Failed to allocate swap snapshot");
+		exit(1);
+	}
+	if (swap_mem != NULL) {
+		memcpy(snap, swap_mem, len);
+	} else if ((n = pread(swapfd, snap, len, 0)) < 0) {
+		// Slots past the end of the file have never been written
+		perror("Failed to read swapfile");
+		exit(1);
+	}
+	return snap;
+}
+
+// Writes the slots in use, their contents from snap, the write-back buffer
+// and the counters to fp.
+void swap_save(FILE *fp, const char *snap) {
+	uint32_t idx, end = UINT32_MAX;
+	int i;
+
+	ckpt_write(fp, &swap_used, sizeof(swap_used));
+	ckpt_write(fp, &swap_peak, sizeof(swap_peak));
+	ckpt_write(fp, &swap_freed, sizeof(swap_freed));
+	ckpt_write(fp, &swap_syscalls, sizeof(swap_syscalls));
+	ckpt_write(fp, &swap_syscalls_per_page, sizeof(swap_syscalls_per_page));
+	ckpt_write(fp, &swap_buffer_reads, sizeof(swap_buffer_reads));
+	ckpt_write(fp, &swapmap->hint, sizeof(swapmap->hint));
+	for (idx = 0; idx < swap_slots; idx++) {
+		if (bitmap_isset(swapmap, idx)) {
+			ckpt_write(fp, &idx, sizeof(idx));
+			ckpt_write(fp, snap + (size_t)idx * SIMPAGESIZE, SIMPAGESIZE);
+		}
+	}
+	ckpt_write(fp, &end, sizeof(end));
+
+	i = swap->init == batch_init ? wb_count : 0;
+	ckpt_write(fp, &i, sizeof(i));
+	ckpt_write(fp, wb_off, i * sizeof(int));
+	ckpt_write(fp, wb_data, i * SIMPAGESIZE);
+}
+
+// Restores what swap_save wrote into the swap space just set up by
+// swap_init, which must be at least as large.
+void swap_load(FILE *fp) {
+	char data[SIMPAGESIZE];
+	uint32_t idx;
+	int i, n;
+
+	ckpt_read(fp, &swap_used, sizeof(swap_used));
+	ckpt_read(fp, &swap_peak, sizeof(swap_peak));
+	ckpt_read(fp, &swap_freed, sizeof(swap_freed));
+	ckpt_read(fp, &swap_syscalls, sizeof(swap_syscalls));
+	ckpt_read(fp, &swap_syscalls_per_page, sizeof(swap_syscalls_per_page));
+	ckpt_read(fp, &swap_buffer_reads, sizeof(swap_buffer_reads));
+	ckpt_read(fp, &swapmap->hint, sizeof(swapmap->hint));
+	while (ckpt_read(fp, &idx, sizeof(idx)), idx != UINT32_MAX) {
+		if (idx >= swap_slots) {
+			fprintf(stderr, "Error: checkpoint needs more than %u swap "
+				"slots\n", swap_slots);
+			exit(1);
+		}
+		ckpt_read(fp, data, SIMPAGESIZE);
+		bitmap_mark(swapmap, idx);
+		if (swap_mem != NULL) {
+			memcpy(swap_mem + (size_t)idx * SIMPAGESIZE, data, SIMPAGESIZE);
+		} else if (pwrite(swapfd, data, SIMPAGESIZE,
+				  (off_t)idx * SIMPAGESIZE) != SIMPAGESIZE) {
+			perror("Failed to restore swapfile");
+			exit(1);
+		}
+	}
+
+	// A buffer saved by the batch backend goes back into the buffer if
+	// this run uses it too, and is written out otherwise
+	ckpt_read(fp, &n, sizeof(n));
+	for (i = 0; i < n; i++) {
+		ckpt_read(fp, &wb_off[i], sizeof(int));
+	}
+	for (i = 0; i < n; i++) {
+		ckpt_read(fp, data, SIMPAGESIZE);
+		if (swap->init == batch_init) {
+			memcpy(wb_data[i], data, SIMPAGESIZE);
+			pagemap_insert(wb_index, wb_off[i], i);
+		} else if (swap_mem != NULL) {
+			memcpy(swap_mem + wb_off[i], data, SIMPAGESIZE);
+		} else if (pwrite(swapfd, data, SIMPAGESIZE, wb_off[i]) !=
+			   SIMPAGESIZE) {
+			perror("Failed to restore swapfile");
+			exit(1);
+		}
+	}
+	if (swap->init == batch_init) {
+		wb_count = n;
+	}
+}
+
 // Read data into (simulated) physical memory 'frame' from 'swap_offset'
 // in swap file.
 // Input:  frame - the physical frame number (not byte offset) in physmem
@@ -186,30 +668,9 @@ void swap_destroy() {
 //	   -errno on error or number of bytes read on partial read
 // 
 int swap_pagein(unsigned frame, int swap_offset) {
-	char *frame_ptr;
-	off_t pos;
-	ssize_t bytes_read;
-	
 	assert(swap_offset != INVALID_SWAP);
-
-	// Get pointer to page data in (simulated) physical memory
-	frame_ptr = &physmem[frame * SIMPAGESIZE];
-
-	// Seek to position in swap file where this page was stored
-	pos = lseek(swapfd, swap_offset, SEEK_SET);
-	if (pos != swap_offset) {
-		assert(pos == (off_t)-1);
-		perror("swap_pagein: failed to set read position");
-		return -errno;
-	}
-
-	// Read page data from swapfile into memory
-	bytes_read = read(swapfd, frame_ptr, SIMPAGESIZE);
-	if (bytes_read != SIMPAGESIZE) {
-		fprintf(stderr,"swap_pagein: did not read whole page\n");
-		return bytes_read;
-	}
-	return 0;
+	swap_syscalls_per_page += 2;
+	return swap->pagein(frame, swap_offset);
 }
 
 // Write data from (simulated) physical memory 'frame' to 'swap_offset'
@@ -220,10 +681,7 @@ int swap_pagein(unsigned frame, int swap_offset) {
 //         or INVALID_SWAP on failure
 // 
 int swap_pageout(unsigned frame, int swap_offset) {
-	char *frame_ptr;
-	off_t pos;
 	unsigned idx;
-	ssize_t bytes_written;
 
 	// Check if swap has already been allocated for this page 
 	if (swap_offset == INVALID_SWAP) {
@@ -232,25 +690,32 @@ int swap_pageout(unsigned frame, int swap_offset) {
 			return INVALID_SWAP;
 		}
 		swap_offset = idx*SIMPAGESIZE;
+		if (++swap_used > swap_peak) {
+			swap_peak = swap_used;
+		}
 	}
 	assert(swap_offset != INVALID_SWAP);
+	swap_syscalls_per_page += 2;
+	return swap->pageout(frame, swap_offset);
+}
 
-	// Get pointer to page data in (simulated) physical memory
-	frame_ptr = &physmem[frame * SIMPAGESIZE];
+// Returns the number of swap slots holding a page.
+unsigned swap_slots_in_use() {
+	return swap_used;
+}
 
-	// Seek to position in swap file where this page will be stored
-	pos = lseek(swapfd, swap_offset, SEEK_SET);
-	if (pos != swap_offset) {
-		assert(pos == (off_t)-1);
-		perror("swap_pageout: failed to set write position");
-		return INVALID_SWAP;
-	}
+// Returns the number of pages the swapfile has room for.
+unsigned swap_slots_total() {
+	return swap_slots;
+}
 
-	// Read page data from swapfile into memory
-	bytes_written = write(swapfd, frame_ptr, SIMPAGESIZE);
-	if (bytes_written != SIMPAGESIZE) {
-		fprintf(stderr,"swap_pageout: did not write whole page\n");
-		return INVALID_SWAP;
-	}
-	return swap_offset;
+// Frees the swap space at 'swap_offset' once the copy there is of no
+// further use, e.g. because the page in memory has been modified since
+// it was read in. The page is given a new slot if it is written out again.
+void swap_free(int swap_offset) {
+	assert(swap_offset != INVALID_SWAP);
+	bitmap_unmark(swapmap, swap_offset / SIMPAGESIZE);
+	swap->discard(swap_offset);
+	swap_used--;
+	swap_freed++;
 }
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "sim.h"
+
+/* Sweep mode runs every (algorithm, memsize) combination against one trace
+ * and prints the same CSV table that traceprogs/gen-table.py builds from
+ * the output of gen-columns.sh.
+ *
+ * The trace is parsed once into trace_buffer. Each configuration is then
+ * simulated by its own worker process: the simulator keeps all of its
+ * state (coremap, page directory, counters, algorithm data) in globals,
+ * so a forked child gets a private copy of that state for free while
+ * sharing the parsed trace with the parent copy-on-write.
+ */
+
+struct sweep_result {
+	unsigned long hit_count;
+	unsigned long miss_count;
+	unsigned long ref_count;
+	unsigned long evict_clean_count;
+	unsigned long evict_dirty_count;
+};
+
+struct sweep_config {
+	char *alg;
+	unsigned memsize;
+	pid_t pid;
+	int fd;                  // Read end of the pipe from the worker
+	int done;                // Set once the result has been collected
+	struct sweep_result res;
+};
+
+/* Simulates one configuration and writes its counters to fd.
+ * Runs in the worker process and never returns.
+ */
+static void sweep_worker(struct sweep_config *c, unsigned swapsize, int fd) {
+	struct sweep_result r;
+	struct trace *tr;
+
+	memsize = c->memsize;
+	select_algorithm(c->alg);
+	init_simulation(swapsize);
+	init_fcn();
+
+	tr = trace_open_buffer(trace_buffer, trace_buffer_len);
+	replay_trace(tr);
+	trace_close(tr);
+	swap_destroy();
+
+	r.hit_count = hit_count;
+	r.miss_count = miss_count;
+	r.ref_count = ref_count;
+	r.evict_clean_count = evict_clean_count;
+	r.evict_dirty_count = evict_dirty_count;
+	if (write(fd, &r, sizeof(r)) != sizeof(r)) {
+		perror("sweep: failed to report results");
+		_exit(1);
+	}
+	_exit(0);
+}
+
+static void sweep_start(struct sweep_config *c, unsigned swapsize) {
+	int pfd[2];
+
+	if (pipe(pfd) == -1) {
+		perror("sweep: pipe");
+		exit(1);
+	}
+	if ((c->pid = fork()) == -1) {
+		perror("sweep: fork");
+		exit(1);
+	}
+	if (c->pid == 0) {
+		close(pfd[0]);
+		sweep_worker(c, swapsize, pfd[1]);
+	}
+	close(pfd[1]);
+	c->fd = pfd[0];
+}
+
+/* Waits for any running worker to finish and collects its results.
+ * Returns 0 if it succeeded, -1 if it failed.
+ */
+static int sweep_reap(struct sweep_config *configs, int n) {
+	int status, i;
+	pid_t pid;
+	struct sweep_config *c = NULL;
+
+	while ((pid = wait(&status)) == -1 && errno == EINTR) {
+	}
+	for (i = 0; i < n; i++) {
+		if (configs[i].pid == pid) {
+			c = &configs[i];
+			break;
+		}
+	}
+	if (c == NULL) {
+		perror("sweep: wait");
+		exit(1);
+	}
+	c->done = WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+		read(c->fd, &c->res, sizeof(c->res)) == sizeof(c->res);
+	close(c->fd);
+	if (!c->done) {
+		fprintf(stderr, "sweep: simulation of %s with memsize %u failed\n",
+				c->alg, c->memsize);
+		return -1;
+	}
+	return 0;
+}
+
+/* Orders rows the way gen-table.py does: by memsize, then by name. */
+static int sweep_cmp(const void *a, const void *b) {
+	const struct sweep_config *x = a, *y = b;
+
+	if (x->memsize != y->memsize) {
+		return x->memsize < y->memsize ? -1 : 1;
+	}
+	return strcmp(x->alg, y->alg);
+}
+
+/* Prints a rate the way Python's str(float) prints the value sim reports
+ * with %.4f, so that the table matches gen-table.py exactly.
+ */
+static void print_rate(double rate) {
+	char buf[64];
+	size_t len;
+
+	snprintf(buf, sizeof(buf), "%.4f", rate);
+	len = strlen(buf);
+	while (buf[len - 1] == '0' && buf[len - 2] != '.') {
+		buf[--len] = '\0';
+	}
+	printf("%s", buf);
+}
+
+static void sweep_print(struct sweep_config *configs, int n) {
+	const char *name = tracefile != NULL ? tracefile : "stdin";
+	int i;
+
+	printf("Tbl,Hit rate,Hit count,Miss count,Overall eviction count,"
+	       "Clean evictions,Dirty evictions\n");
+	for (i = 0; i < n; i++) {
+		struct sweep_result *r = &configs[i].res;
+		printf("%s-%s-%u,", name, configs[i].alg, configs[i].memsize);
+		print_rate((double)r->hit_count/r->ref_count * 100);
+		printf(",%lu,%lu,%lu,%lu,%lu\n", r->hit_count, r->miss_count,
+		       r->evict_clean_count + r->evict_dirty_count,
+		       r->evict_clean_count, r->evict_dirty_count);
+	}
+}
+
+/* Runs the sweep for the comma-separated lists of algorithms and memory
+ * sizes. At most one worker per online CPU runs at a time.
+ * Returns the exit status for sim.
+ */
+int run_sweep(char *alg_list, char *memsize_list, unsigned swapsize) {
+	char *algv[MAXLINE], *sizev[MAXLINE];
+	int nalgs = 0, nsizes = 0;
+	int n, i, j, running = 0, next = 0, failed = 0;
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	struct sweep_config *configs;
+	char *tok;
+
+	for (tok = strtok(alg_list, ","); tok != NULL && nalgs < MAXLINE;
+	     tok = strtok(NULL, ",")) {
+		if (select_algorithm(tok) != 0) {
+			fprintf(stderr, "Error: invalid replacement algorithm - %s\n",
+					tok);
+			exit(1);
+		}
+		if (replace_local && evict_local_fcn == NULL) {
+			fprintf(stderr, "Error: %s does not support local replacement\n",
+					tok);
+			exit(1);
+		}
+		algv[nalgs++] = tok;
+	}
+	for (tok = strtok(memsize_list, ","); tok != NULL && nsizes < MAXLINE;
+	     tok = strtok(NULL, ",")) {
+		if (strtoul(tok, NULL, 10) == 0) {
+			fprintf(stderr, "Error: invalid memory size - %s\n", tok);
+			exit(1);
+		}
+		sizev[nsizes++] = tok;
+	}
+
+	n = nalgs * nsizes;
+	configs = calloc(n, sizeof(struct sweep_config));
+	for (i = 0; i < nsizes; i++) {
+		for (j = 0; j < nalgs; j++) {
+			configs[i*nalgs + j].alg = algv[j];
+			configs[i*nalgs + j].memsize =
+				(unsigned)strtoul(sizev[i], NULL, 10);
+		}
+	}
+
+	// Parse the trace exactly once; every worker replays this buffer
+	trace_buffer = trace_load(tracefile, &trace_buffer_len);
+	fflush(stdout);
+
+	if (ncpus < 1) {
+		ncpus = 1;
+	}
+	while (next < n || running > 0) {
+		if (next < n && running < ncpus) {
+			sweep_start(&configs[next++], swapsize);
+			running++;
+		} else {
+			if (sweep_reap(configs, n) != 0) {
+				failed = 1;
+			}
+			running--;
+		}
+	}
+	if (failed) {
+		return 1;
+	}
+
+	qsort(configs, n, sizeof(struct sweep_config), sweep_cmp);
+	sweep_print(configs, n);
+	free(configs);
+	free(trace_buffer);
+	return 0;
+}
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "pagetable.h"
+#include "sim.h"
+#include "tlb.h"
+
+/* A set-associative TLB in front of the page table walk (--tlb).
+ *
+ * Each entry maps a virtual page number to its page table entry, and only
+ * ever holds pages that are resident: an entry is filled after a
+ * reference has been translated, and dropped when its frame is evicted or
+ * freed. A hit therefore skips the page table walk altogether. The
+ * entries of set s are tlb_vpn[s*ways] to tlb_vpn[s*ways + ways - 1], and
+ * tlb_slot records which entry (if any) maps each frame, so eviction can
+ * invalidate it without a search. Entries are tagged with the pid (as with
+ * an ASID), so a process switch does not flush the TLB.
+ */
+
+#define TLB_EMPTY (~0UL)
+
+int tlb_entries = 0;          // 0 means no TLB
+int tlb_ways = 0;
+int tlb_random = 0;           // Random rather than LRU replacement in a set
+
+static int tlb_sets;
+static unsigned long *tlb_vpn;
+static pgtbl_entry_t **tlb_pte;
+static int *tlb_frame;
+static unsigned long *tlb_used;  // When each entry was last used, for LRU
+static unsigned long tlb_clock;
+static int *tlb_slot;            // Entry mapping each frame, or -1
+static unsigned long tlb_rand_state;
+
+static unsigned long tlb_hits = 0;
+static unsigned long tlb_misses = 0;
+
+/* Parses an --tlb argument of the form entries,ways[,lru|random].
+ * Returns 0 on success, -1 if it is malformed.
+ */
+int tlb_configure(char *spec) {
+	char *end, *policy;
+
+	tlb_entries = (int)strtol(spec, &end, 10);
+	if (*end != ',') {
+		return -1;
+	}
+	tlb_ways = (int)strtol(end + 1, &end, 10);
+	if (*end == ',') {
+		policy = end + 1;
+		if (strcmp(policy, "random") == 0) {
+			tlb_random = 1;
+		} else if (strcmp(policy, "lru") != 0) {
+			return -1;
+		}
+	} else if (*end != '\0') {
+		return -1;
+	}
+	if (tlb_entries <= 0 || tlb_ways <= 0 || tlb_entries % tlb_ways != 0) {
+		return -1;
+	}
+	return 0;
+}
+
+void tlb_init() {
+	int i;
+
+	if (tlb_entries == 0) {
+		return;
+	}
+	tlb_sets = tlb_entries / tlb_ways;
+	tlb_vpn = malloc(tlb_entries * sizeof(unsigned long));
+	tlb_pte = malloc(tlb_entries * sizeof(pgtbl_entry_t *));
+	tlb_frame = malloc(tlb_entries * sizeof(int));
+	tlb_used = calloc(tlb_entries, sizeof(unsigned long));
+	tlb_slot = malloc(memsize * sizeof(int));
+	if (tlb_vpn == NULL || tlb_pte == NULL || tlb_frame == NULL ||
+	    tlb_used == NULL || tlb_slot == NULL) {
+		perror("Failed to allocate TLB");
+		exit(1);
+	}
+	for (i = 0; i < tlb_entries; i++) {
+		tlb_vpn[i] = TLB_EMPTY;
+	}
+	for (i = 0; i < memsize; i++) {
+		tlb_slot[i] = -1;
+	}
+	tlb_clock = 0;
+	tlb_rand_state = 88172645463325252UL;
+}
+
+/* Returns the page table entry for vaddr if the TLB holds it, or NULL. */
+pgtbl_entry_t *tlb_lookup(addr_t vaddr) {
+	unsigned long vpn = TRACE_PAGE(curproc->pid, vaddr);
+	int base = (vpn % tlb_sets) * tlb_ways;
+	int i;
+
+	for (i = base; i < base + tlb_ways; i++) {
+		if (tlb_vpn[i] == vpn) {
+			tlb_used[i] = ++tlb_clock;
+			tlb_hits++;
+			return tlb_pte[i];
+		}
+	}
+	tlb_misses++;
+	return NULL;
+}
+
+/* Adds the translation of vaddr to p, which must be resident, replacing an
+ * empty entry of its set if there is one, otherwise the least recently
+ * used (or a random) entry.
+ */
+void tlb_insert(addr_t vaddr, pgtbl_entry_t *p) {
+	unsigned long vpn = TRACE_PAGE(curproc->pid, vaddr);
+	int base = (vpn % tlb_sets) * tlb_ways;
+	int frame = p->frame >> PAGE_SHIFT;
+	int i, victim = base;
+
+	assert(p->frame & PG_VALID);
+	for (i = base; i < base + tlb_ways; i++) {
+		if (tlb_vpn[i] == TLB_EMPTY) {
+			victim = i;
+			break;
+		}
+		if (tlb_used[i] < tlb_used[victim]) {
+			victim = i;
+		}
+	}
+	if (i == base + tlb_ways && tlb_random) {
+		// xorshift, so as not to disturb the sequence rand_evict sees
+		tlb_rand_state ^= tlb_rand_state << 13;
+		tlb_rand_state ^= tlb_rand_state >> 7;
+		tlb_rand_state ^= tlb_rand_state << 17;
+		victim = base + tlb_rand_state % tlb_ways;
+	}
+
+	if (tlb_vpn[victim] != TLB_EMPTY) {
+		tlb_slot[tlb_frame[victim]] = -1;
+	}
+	tlb_vpn[victim] = vpn;
+	tlb_pte[victim] = p;
+	tlb_frame[victim] = frame;
+	tlb_used[victim] = ++tlb_clock;
+	tlb_slot[frame] = victim;
+}
+
+/* Drops any translation to frame, whose page is leaving memory. */
+void tlb_invalidate_frame(int frame) {
+	int i = tlb_slot[frame];
+
+	if (i != -1) {
+		tlb_vpn[i] = TLB_EMPTY;
+		tlb_slot[frame] = -1;
+	}
+}
+
+void tlb_report() {
+	unsigned long lookups = tlb_hits + tlb_misses;
+
+	if (tlb_entries == 0) {
+		return;
+	}
+	printf("TLB: %d entries, %d-way, %s replacement\n", tlb_entries,
+	       tlb_ways, tlb_random ? "random" : "LRU");
+	printf("TLB hits: %lu, misses: %lu, hit rate: %.4f\n", tlb_hits,
+	       tlb_misses, lookups ? (double)tlb_hits / lookups * 100 : 0.0);
+}
@@ -0,0 +1,19 @@
+#ifndef __TLB_H__
+#define __TLB_H__
+
+#include "pagetable.h"
+
+/* The TLB modelled with --tlb entries,ways[,lru|random]. tlb_lookup is
+ * tried before the page table walk, and tlb_insert fills an entry once a
+ * reference has been translated. Entries only map resident pages.
+ */
+extern int tlb_entries;        // 0 if there is no TLB
+
+extern int tlb_configure(char *spec);
+extern void tlb_init(void);
+extern pgtbl_entry_t *tlb_lookup(addr_t vaddr);
+extern void tlb_insert(addr_t vaddr, pgtbl_entry_t *p);
+extern void tlb_invalidate_frame(int frame);
+extern void tlb_report(void);
+
+#endif /* __TLB_H__ */
@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sim.h"
+#include "trace.h"
+#include "pagemap.h"
+
+/* Maps a binary trace file into memory and checks its header.
+ * Returns 0 on success, -1 if the file is not a valid binary trace.
+ */
+static int trace_map(struct trace *t, int fd, const char *path) {
+	struct stat st;
+	struct trace_header hdr;
+
+	if (fstat(fd, &st) == -1) {
+		perror("Error reading tracefile:");
+		return -1;
+	}
+	if ((size_t)st.st_size < sizeof(hdr)) {
+		fprintf(stderr, "Error: binary trace %s is truncated\n", path);
+		return -1;
+	}
+	t->maplen = st.st_size;
+	t->map = mmap(NULL, t->maplen, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (t->map == MAP_FAILED) {
+		perror("Error mapping tracefile:");
+		return -1;
+	}
+	// The whole file is read front to back exactly once per pass
+	madvise(t->map, t->maplen, MADV_SEQUENTIAL);
+
+	memcpy(&hdr, t->map, sizeof(hdr));
+	if (hdr.version != TRACE_VERSION || (hdr.flags & ~TRACE_FLAG_PIDS) != 0) {
+		fprintf(stderr, "Error: unsupported binary trace version %u in %s\n",
+				hdr.version, path);
+		munmap(t->map, t->maplen);
+		return -1;
+	}
+	t->flags = hdr.flags;
+	t->nrefs = hdr.nrefs;
+	t->left = hdr.nrefs;
+	t->pos = sizeof(hdr);
+	return 0;
+}
+
+/* Opens a trace for replay. If path is NULL the trace is read as text
+ * from stdin. Otherwise the format is detected from the magic at the start
+ * of the file. Exits on error, like the rest of the simulator setup code.
+ */
+struct trace *trace_open(const char *path) {
+	struct trace *t = calloc(1, sizeof(struct trace));
+	char magic[TRACE_MAGIC_LEN];
+	int fd;
+
+	if (t == NULL) {
+		perror("Failed to allocate trace");
+		exit(1);
+	}
+	if (path == NULL) {
+		t->fp = stdin;
+		return t;
+	}
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		perror("Error opening tracefile:");
+		exit(1);
+	}
+	if (read(fd, magic, TRACE_MAGIC_LEN) == TRACE_MAGIC_LEN &&
+	    memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN) == 0) {
+		if (trace_map(t, fd, path) != 0) {
+			exit(1);
+		}
+		close(fd);
+		return t;
+	}
+
+	// Not a binary trace, so fall back to the text reader
+	lseek(fd, 0, SEEK_SET);
+	if ((t->fp = fdopen(fd, "r")) == NULL) {
+		perror("Error opening tracefile:");
+		exit(1);
+	}
+	return t;
+}
+
+/* Opens a trace that replays n references from an in-memory buffer.
+ * The buffer is not copied, and must outlive the trace.
+ */
+struct trace *trace_open_buffer(const trace_ref_t *refs, uint64_t n) {
+	struct trace *t = calloc(1, sizeof(struct trace));
+
+	if (t == NULL) {
+		perror("Failed to allocate trace");
+		exit(1);
+	}
+	t->refs = refs;
+	t->nrefs = n;
+	t->left = n;
+	return t;
+}
+
+/* Reads a whole trace (text or binary, or stdin if path is NULL) into a
+ * newly allocated buffer of packed references, so that it only needs to be
+ * parsed once no matter how many times it is replayed.
+ * Returns the buffer and sets *nrefs to the number of references in it.
+ */
+trace_ref_t *trace_load(const char *path, uint64_t *nrefs) {
+	struct trace *t = trace_open(path);
+	uint64_t cap = t->nrefs > 0 ? t->nrefs : 4096;
+	uint64_t n = 0;
+	trace_ref_t *refs = malloc(cap * sizeof(trace_ref_t));
+	char type;
+	addr_t vaddr;
+
+	while (refs != NULL && trace_next(t, &type, &vaddr)) {
+		if (n == cap) {
+			// Text traces do not record their length, so grow as we go
+			cap *= 2;
+			refs = realloc(refs, cap * sizeof(trace_ref_t));
+			if (refs == NULL) {
+				break;
+			}
+		}
+		if (vaddr >> TRACE_VADDR_BITS) {
+			fprintf(stderr, "Error: address %lx in trace is wider than %d "
+				"bits\n", vaddr, TRACE_VADDR_BITS);
+			exit(1);
+		}
+		refs[n++] = TRACE_REF(type, t->pid, vaddr);
+	}
+	if (refs == NULL) {
+		perror("Failed to allocate memory for trace");
+		exit(1);
+	}
+	trace_close(t);
+	*nrefs = n;
+	return refs;
+}
+
+/* Computes, for every reference in a loaded trace, the index of the next
+ * reference to the same page, or n if the page is never referenced again.
+ * This is done in one backward pass with a map from each page to the
+ * lowest index seen so far. If npages is not NULL, it is set to the number
+ * of distinct pages in the trace.
+ */
+uint64_t *trace_next_use(const trace_ref_t *refs, uint64_t n, uint64_t *npages) {
+	uint64_t *next_use = malloc(n * sizeof(uint64_t));
+	struct pagemap *last = pagemap_create(0);
+	uint64_t i;
+
+	if (n > 0 && next_use == NULL) {
+		perror("Failed to allocate next-use array");
+		exit(1);
+	}
+	for (i = n; i-- > 0; ) {
+		unsigned long page = TRACE_REF_PAGE(refs[i]);
+		long *slot = pagemap_lookup(last, page);
+		if (slot != NULL) {
+			next_use[i] = (uint64_t)*slot;
+			*slot = (long)i;
+		} else {
+			next_use[i] = n;
+			pagemap_insert(last, page, (long)i);
+		}
+	}
+	if (npages != NULL) {
+		*npages = last->size;
+	}
+	pagemap_destroy(last);
+	return next_use;
+}
+
+/* Reads the next reference from a text trace, skipping the '=' comment
+ * lines that valgrind writes. A number after the address field is the pid.
+ */
+static int trace_next_text(struct trace *t, char *type, addr_t *vaddr) {
+	char buf[MAXLINE];
+	char *p, *end;
+	int n = 0;
+	long pid;
+
+	while (fgets(buf, MAXLINE, t->fp) != NULL) {
+		if (buf[0] != '=') {
+			sscanf(buf, "%c %lx%n", type, &t->last_vaddr, &n);
+			*vaddr = t->last_vaddr;
+
+			// Skip the rest of the address field (e.g. ",8")
+			for (p = buf + n; *p != '\0' && *p != ' ' && *p != '\t' &&
+			     *p != '\n'; p++) {
+			}
+			pid = strtol(p, &end, 10);
+			if (end == p) {
+				pid = 0;
+			} else if (pid < 0 || pid > TRACE_MAX_PID) {
+				fprintf(stderr, "Error: pid %ld in trace is out of range "
+					"(0 to %d)\n", pid, TRACE_MAX_PID);
+				exit(1);
+			}
+			t->pid = (int)pid;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Exits on a binary trace that ends in the middle of a record, or before
+ * all the references its header counts.
+ */
+static void trace_truncated() {
+	fprintf(stderr, "Error: binary trace is truncated\n");
+	exit(1);
+}
+
+/* Reads the byte at *p in t's mapping, advancing *p past it. */
+static unsigned char read_byte(struct trace *t, unsigned char **p) {
+	if (*p >= t->map + t->maplen) {
+		trace_truncated();
+	}
+	return *(*p)++;
+}
+
+/* Decodes the LEB128 varint at *p, advancing *p past it. */
+static uint64_t read_varint(struct trace *t, unsigned char **p) {
+	uint64_t v = 0;
+	int shift = 0;
+	unsigned char b;
+
+	do {
+		if (shift > 63) {
+			trace_truncated();   // No varint of ours is this long
+		}
+		b = read_byte(t, p);
+		v |= (uint64_t)(b & 0x7f) << shift;
+		shift += 7;
+	} while (b & 0x80);
+	return v;
+}
+
+/* Gets the next reference in the trace.
+ * Returns 1 and fills in type and vaddr if there was one, 0 at the end.
+ */
+int trace_next(struct trace *t, char *type, addr_t *vaddr) {
+	unsigned char *p;
+	uint64_t zz, pid;
+
+	if (t->fp != NULL) {
+		return trace_next_text(t, type, vaddr);
+	}
+	if (t->left == 0) {
+		return 0;
+	}
+	if (t->refs != NULL) {
+		trace_ref_t r = t->refs[t->nrefs - t->left--];
+		*type = TRACE_REF_TYPE(r);
+		*vaddr = TRACE_REF_VADDR(r);
+		t->pid = TRACE_REF_PID(r);
+		return 1;
+	}
+	p = t->map + t->pos;
+	*type = (char)read_byte(t, &p);
+	while (*type == 'P' && (t->flags & TRACE_FLAG_PIDS)) {
+		// Switch process, then on to the reference itself
+		pid = read_varint(t, &p);
+		if (pid > TRACE_MAX_PID) {
+			fprintf(stderr, "Error: pid %lu in trace is out of range "
+				"(0 to %d)\n", (unsigned long)pid, TRACE_MAX_PID);
+			exit(1);
+		}
+		t->pid = (int)pid;
+		*type = (char)read_byte(t, &p);
+	}
+	zz = read_varint(t, &p);
+	t->pos = p - t->map;
+	t->left--;
+
+	// Undo the zigzag encoding to recover the signed delta
+	t->last_vaddr += (addr_t)((zz >> 1) ^ -(zz & 1));
+	*vaddr = t->last_vaddr;
+	return 1;
+}
+
+/* Restarts the trace from its first reference. Not possible on stdin. */
+void trace_rewind(struct trace *t) {
+	t->last_vaddr = 0;
+	t->pid = 0;
+	if (t->fp != NULL) {
+		assert(t->fp != stdin);
+		rewind(t->fp);
+		return;
+	}
+	t->pos = sizeof(struct trace_header);
+	t->left = t->nrefs;
+}
+
+/* Records where t is up to in pos. Returns 0 on success, or -1 if the
+ * position of a text trace cannot be told (e.g. on a pipe).
+ */
+int trace_tell(struct trace *t, struct trace_pos *pos) {
+	off_t off = 0;
+
+	memset(pos, 0, sizeof(*pos));
+	if (t->fp != NULL && (off = ftello(t->fp)) == -1) {
+		return -1;
+	}
+	pos->offset = t->fp != NULL ? (uint64_t)off : t->pos;
+	pos->left = t->left;
+	pos->last_vaddr = t->last_vaddr;
+	pos->pid = t->pid;
+	return 0;
+}
+
+/* Moves t to a position recorded by trace_tell on the same trace.
+ * Returns 0 on success, -1 if the position is not in the trace.
+ */
+int trace_seek(struct trace *t, const struct trace_pos *pos) {
+	if (t->fp != NULL) {
+		if (t->fp == stdin || fseeko(t->fp, (off_t)pos->offset, SEEK_SET) != 0) {
+			return -1;
+		}
+	} else if (pos->left > t->nrefs ||
+		   (t->map != NULL && (pos->offset < sizeof(struct trace_header) ||
+				       pos->offset > t->maplen))) {
+		return -1;
+	} else {
+		t->pos = pos->offset;
+		t->left = pos->left;
+	}
+	t->last_vaddr = pos->last_vaddr;
+	t->pid = pos->pid;
+	return 0;
+}
+
+void trace_close(struct trace *t) {
+	if (t->fp != NULL) {
+		if (t->fp != stdin) {
+			fclose(t->fp);
+		}
+	} else if (t->map != NULL) {
+		munmap(t->map, t->maplen);
+	}
+	free(t);
+}
+
+//---------------------------------------------------------------------
+// Writing binary traces (used by the trconv tool).
+
+/* Writes a binary trace header at the current position of fp.
+ * Returns 0 on success, -1 on error.
+ */
+int trace_write_header(FILE *fp, uint64_t nrefs, uint32_t flags) {
+	struct trace_header hdr;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, TRACE_MAGIC, TRACE_MAGIC_LEN);
+	hdr.version = TRACE_VERSION;
+	hdr.flags = flags;
+	hdr.nrefs = nrefs;
+	return fwrite(&hdr, sizeof(hdr), 1, fp) == 1 ? 0 : -1;
+}
+
+/* Writes a record of the given type byte followed by v as a LEB128
+ * varint. Returns 0 on success, -1 on error.
+ */
+static int write_record(FILE *fp, char type, uint64_t v) {
+	unsigned char buf[1 + 10];
+	int n = 0;
+
+	buf[n++] = (unsigned char)type;
+	do {
+		buf[n] = v & 0x7f;
+		v >>= 7;
+		if (v != 0) {
+			buf[n] |= 0x80;
+		}
+		n++;
+	} while (v != 0);
+	return fwrite(buf, 1, n, fp) == (size_t)n ? 0 : -1;
+}
+
+/* Appends a record switching to process pid. The header written for the
+ * trace must have TRACE_FLAG_PIDS set. Returns 0 on success, -1 on error.
+ */
+int trace_write_pid(FILE *fp, int pid) {
+	return write_record(fp, 'P', (uint64_t)pid);
+}
+
+/* Appends one reference record. 'last' holds the previous vaddr written
+ * and is updated. Returns 0 on success, -1 on error.
+ */
+int trace_write_ref(FILE *fp, char type, addr_t vaddr, addr_t *last) {
+	int64_t delta = (int64_t)(vaddr - *last);
+	uint64_t zz = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+
+	*last = vaddr;
+	return write_record(fp, type, zz);
+}
@@ -0,0 +1,108 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "pagetable.h"
+
+/* Binary trace format.
+ *
+ * A binary trace starts with a fixed-size header, followed by one record
+ * per memory reference. Each record is the reference type byte ('I', 'L',
+ * 'S' or 'M') followed by the difference between this vaddr and the
+ * previous one, zigzag-encoded and stored as a LEB128 varint. Consecutive
+ * references in real traces are usually close together, so most records
+ * fit in 2-4 bytes instead of the ~15 bytes of a text line.
+ *
+ * The first byte of the magic is not printable, so a binary trace can never
+ * be mistaken for a text trace.
+ *
+ * A trace of several processes has TRACE_FLAG_PIDS set. Each reference
+ * then belongs to the process named by the last 'P' record before it,
+ * whose pid follows as a LEB128 varint (0 until the first one). 'P'
+ * records are not counted in nrefs, and the vaddr deltas run on across
+ * them.
+ */
+#define TRACE_MAGIC     "\177SIMTRC"
+#define TRACE_MAGIC_LEN 8
+#define TRACE_VERSION   1
+#define TRACE_FLAG_PIDS 0x1   // The trace has 'P' (switch process) records
+
+// In a text trace, the pid is an optional last field on each line, as in
+//     L 7ff000e88,8 3
+// and a line without one belongs to process 0. Pids go up to TRACE_MAX_PID.
+#define TRACE_PID_BITS  8
+#define TRACE_MAX_PID   ((1 << TRACE_PID_BITS) - 1)
+
+struct trace_header {
+	char magic[TRACE_MAGIC_LEN];
+	uint32_t version;
+	uint32_t flags;       // TRACE_FLAG_*; other bits must be zero
+	uint64_t nrefs;       // Number of reference records that follow
+};
+
+/* A trace that has been loaded into memory is an array of packed
+ * references. User-level vaddrs fit in 48 bits, so the reference type is
+ * kept in the top byte and the pid in the byte below it, and each
+ * reference takes only 8 bytes.
+ */
+typedef uint64_t trace_ref_t;
+#define TRACE_VADDR_BITS        48
+#define TRACE_REF(type, pid, vaddr) \
+	(((uint64_t)(unsigned char)(type) << 56) | \
+	 ((uint64_t)(pid) << TRACE_VADDR_BITS) | (vaddr))
+#define TRACE_REF_TYPE(r)       ((char)((r) >> 56))
+#define TRACE_REF_PID(r)        ((int)(((r) >> TRACE_VADDR_BITS) & TRACE_MAX_PID))
+#define TRACE_REF_VADDR(r)      ((addr_t)((r) & ((1UL << TRACE_VADDR_BITS) - 1)))
+
+// A number that identifies a virtual page across all processes, for
+// anything that keeps per-page history of a trace
+#define TRACE_PAGE(pid, vaddr) \
+	(((unsigned long)(pid) << (TRACE_VADDR_BITS - PAGE_SHIFT)) | \
+	 ((vaddr) >> PAGE_SHIFT))
+#define TRACE_REF_PAGE(r)       TRACE_PAGE(TRACE_REF_PID(r), TRACE_REF_VADDR(r))
+
+/* A trace being replayed. Text traces are read with stdio, binary traces
+ * are mmap'd and decoded in place, so no text parsing is done for them.
+ * A trace can also be replayed from a buffer filled in by trace_load().
+ */
+struct trace {
+	FILE *fp;             // Text trace, or NULL for a binary trace
+	const trace_ref_t *refs; // Loaded trace, or NULL
+	unsigned char *map;   // Start of the mapped binary trace file
+	size_t maplen;        // Length of the mapping
+	size_t pos;           // Byte offset of the next record in map
+	uint64_t nrefs;       // Number of references, or 0 if unknown (text)
+	uint64_t left;        // References not yet returned (binary/loaded)
+	addr_t last_vaddr;    // Previous vaddr, the base for the next delta
+	int pid;              // Process of the reference last returned
+	int flags;            // TRACE_FLAG_* from the header (binary)
+};
+
+/* Where a trace is up to, so that replay can be picked up again there by
+ * another run (for sim --resume). Only meaningful for the same file.
+ */
+struct trace_pos {
+	uint64_t offset;      // Byte offset of the next record or line
+	uint64_t left;        // References not yet returned (binary/loaded)
+	addr_t last_vaddr;
+	int32_t pid;
+	int32_t pad;
+};
+
+extern struct trace *trace_open(const char *path);
+extern struct trace *trace_open_buffer(const trace_ref_t *refs, uint64_t n);
+extern trace_ref_t *trace_load(const char *path, uint64_t *nrefs);
+extern uint64_t *trace_next_use(const trace_ref_t *refs, uint64_t n,
+		uint64_t *npages);
+extern int trace_next(struct trace *t, char *type, addr_t *vaddr);
+extern void trace_rewind(struct trace *t);
+extern int trace_tell(struct trace *t, struct trace_pos *pos);
+extern int trace_seek(struct trace *t, const struct trace_pos *pos);
+extern void trace_close(struct trace *t);
+
+extern int trace_write_header(FILE *fp, uint64_t nrefs, uint32_t flags);
+extern int trace_write_ref(FILE *fp, char type, addr_t vaddr, addr_t *last);
+extern int trace_write_pid(FILE *fp, int pid);
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "sim.h"
+#include "trace.h"
+
+/* Converts a text trace (as read by sim) into the binary trace format
+ * described in trace.h, so that sim can replay it without parsing.
+ * With -t, converts a binary trace back into text instead.
+ */
+int main(int argc, char *argv[]) {
+	int opt;
+	int to_text = 0;
+	char *usage = "USAGE: trconv [-t] infile outfile\n";
+	struct trace *t;
+	FILE *out;
+	char type;
+	addr_t vaddr;
+	addr_t last = 0;
+	uint64_t nrefs = 0;
+	uint32_t flags = 0;
+	int pid = 0;
+
+	while ((opt = getopt(argc, argv, "t")) != -1) {
+		switch (opt) {
+		case 't':
+			to_text = 1;
+			break;
+		default:
+			fprintf(stderr, "%s", usage);
+			exit(1);
+		}
+	}
+	if (argc - optind != 2) {
+		fprintf(stderr, "%s", usage);
+		exit(1);
+	}
+
+	t = trace_open(argv[optind]);
+	if ((out = fopen(argv[optind + 1], "w")) == NULL) {
+		perror("Error opening output file:");
+		exit(1);
+	}
+
+	if (to_text) {
+		while (trace_next(t, &type, &vaddr)) {
+			if (t->pid != 0) {
+				fprintf(out, "%c %lx %d\n", type, vaddr, t->pid);
+			} else {
+				fprintf(out, "%c %lx\n", type, vaddr);
+			}
+		}
+	} else {
+		// The reference count is not known until the end, so write a
+		// placeholder header now and fill it in afterwards.
+		if (trace_write_header(out, 0, 0) != 0) {
+			perror("Error writing output file:");
+			exit(1);
+		}
+		while (trace_next(t, &type, &vaddr)) {
+			if (t->pid != pid) {
+				pid = t->pid;
+				flags |= TRACE_FLAG_PIDS;
+				if (trace_write_pid(out, pid) != 0) {
+					perror("Error writing output file:");
+					exit(1);
+				}
+			}
+			if (trace_write_ref(out, type, vaddr, &last) != 0) {
+				perror("Error writing output file:");
+				exit(1);
+			}
+			nrefs++;
+		}
+		if (fseek(out, 0, SEEK_SET) != 0 ||
+		    trace_write_header(out, nrefs, flags) != 0) {
+			perror("Error writing output file:");
+			exit(1);
+		}
+	}
+
+	trace_close(t);
+	if (fclose(out) != 0) {
+		perror("Error writing output file:");
+		exit(1);
+	}
+	return 0;
+}
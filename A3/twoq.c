@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include "pagetable.h"
+#include "sim.h"
+#include "ilist.h"
+
+/* 2Q (Johnson and Shasha, VLDB 1994), the full version.
+ *
+ * A page seen for the first time goes into A1in, a FIFO holding about a
+ * quarter of memory, and is not promoted however often it is hit while
+ * there. When it falls out of A1in it is remembered in the ghost FIFO
+ * A1out. Only a page that faults again while in A1out is considered hot
+ * and goes into Am, which is managed as LRU. A scan therefore only churns
+ * A1in and A1out.
+ */
+
+#define A1IN 0
+#define AM   1
+#define A1OUT 0
+
+static struct ilist *res;     // A1in and Am, over frame numbers
+static struct ghost *a1out;
+static int kin;               // Target size of A1in
+
+/* Page to evict is chosen using the 2Q algorithm.
+ * Returns the page frame number (which is also the index in the coremap)
+ * for the page that is to be evicted.
+ */
+int twoq_evict() {
+	int frame;
+
+	if (res->size[A1IN] > kin || res->size[AM] == 0) {
+		frame = ilist_tail(res, A1IN);
+		ilist_remove(res, frame);
+		if (a1out->nfree == 0) {
+			ghost_remove(a1out, ilist_tail(a1out->l, A1OUT));
+		}
+		ghost_add(a1out, A1OUT, coremap[frame].pte);
+	} else {
+		frame = ilist_tail(res, AM);
+		ilist_remove(res, frame);
+	}
+	return frame;
+}
+
+/* This function is called on each access to a page to update any information
+ * needed by the 2Q algorithm.
+ * Input: The page table entry for the page that is being accessed.
+ */
+void twoq_ref(pgtbl_entry_t *p) {
+	int frame = p->frame >> PAGE_SHIFT;
+	int slot;
+
+	switch (res->which[frame]) {
+	case AM:
+		ilist_remove(res, frame);
+		ilist_push(res, AM, frame);
+		break;
+	case A1IN:
+		// Correlated references while in A1in do not count
+		break;
+	default:
+		if ((slot = ghost_find(a1out, p)) != -1) {
+			ghost_remove(a1out, slot);
+			ilist_push(res, AM, frame);
+		} else {
+			ilist_push(res, A1IN, frame);
+		}
+	}
+}
+
+/* Initialize any data structures needed for this
+ * replacement algorithm. Uses the sizes recommended in the paper:
+ * Kin is 25% of memory and Kout (the size of A1out) is 50%.
+ */
+void twoq_init() {
+	res = ilist_create(memsize, 2);
+	kin = memsize / 4 > 0 ? memsize / 4 : 1;
+	a1out = ghost_create(memsize / 2 > 0 ? memsize / 2 : 1, 1);
+}
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include "pagetable.h"
+#include "sim.h"
+#include "pagemap.h"
+
+/* Streaming OPT ("wopt") with a bounded lookahead window.
+ *
+ * Plain OPT needs next-use times for the whole trace before replay starts,
+ * so it cannot run on traces that do not fit in memory. wopt instead reads
+ * the trace through a second, independent reader that stays opt_window
+ * references ahead of the replay. Next uses are only known inside that
+ * window; a resident page whose next use lies beyond it ranks behind all
+ * pages with a known next use, and among those the least recently used
+ * is evicted first. Memory use is O(opt_window + memsize), whatever the
+ * length of the trace.
+ *
+ * With --compare-opt the trace is also loaded in full and the exact OPT
+ * miss count is reported next to the windowed one.
+ */
+
+#define NO_NEXT   UINT64_MAX
+// Keys for pages with no known next use sort above every trace position
+#define UNKNOWN   ((uint64_t)1 << 62)
+
+static struct trace *ahead;  // Reader running ahead of the replay
+static uint64_t window;      // Lookahead window size (opt_window)
+static unsigned long *ring_page; // Page of each reference in the window
+static uint64_t *ring_next;  // Next reference to the same page, in window
+static uint64_t cursor;      // Index of the reference being replayed
+static uint64_t filled;      // Number of references read by 'ahead'
+
+static struct pagemap *tail; // Page -> last position read, if in window
+static struct pagemap *where;// Resident page -> frame holding it
+static unsigned long *frame_page; // Page held by each frame
+
+static uint64_t *key;        // Eviction priority of each frame
+static int *heap;            // Frames, ordered as a max-heap on key
+static int *heap_pos;        // Position of each frame in heap, or -1
+static int heap_size;
+
+static void heap_swap(int i, int j) {
+	int tmp = heap[i];
+	heap[i] = heap[j];
+	heap[j] = tmp;
+	heap_pos[heap[i]] = i;
+	heap_pos[heap[j]] = j;
+}
+
+static void bubble_up(int index) {
+	while (index > 0) {
+		int parent = (index - 1) / 2;
+		if (key[heap[parent]] >= key[heap[index]]) {
+			return;
+		}
+		heap_swap(parent, index);
+		index = parent;
+	}
+}
+
+static void bubble_down(int index) {
+	while (1) {
+		int largest = index;
+		int child1 = 2 * index + 1;
+		int child2 = 2 * index + 2;
+		if (child1 < heap_size && key[heap[child1]] > key[heap[largest]]) {
+			largest = child1;
+		}
+		if (child2 < heap_size && key[heap[child2]] > key[heap[largest]]) {
+			largest = child2;
+		}
+		if (largest == index) {
+			return;
+		}
+		heap_swap(index, largest);
+		index = largest;
+	}
+}
+
+static void set_key(int frame, uint64_t k) {
+	key[frame] = k;
+	bubble_up(heap_pos[frame]);
+	bubble_down(heap_pos[frame]);
+}
+
+/* Reads one more reference into the window. If the page was seen earlier
+ * in the window, links that occurrence to this one. If the page is
+ * resident with no known next use, this is its next use.
+ */
+static int window_extend() {
+	char type;
+	addr_t vaddr;
+	unsigned long page;
+	uint64_t slot = filled % window;
+	long *prev, *frame;
+
+	if (!trace_next(ahead, &type, &vaddr)) {
+		return 0;
+	}
+	page = TRACE_PAGE(ahead->pid, vaddr);
+	ring_page[slot] = page;
+	ring_next[slot] = NO_NEXT;
+
+	if ((prev = pagemap_lookup(tail, page)) != NULL) {
+		ring_next[*prev % window] = filled;
+		*prev = (long)filled;
+	} else {
+		pagemap_insert(tail, page, (long)filled);
+		frame = pagemap_lookup(where, page);
+		if (frame != NULL && key[*frame] >= UNKNOWN) {
+			set_key(*frame, filled);
+		}
+	}
+	filled++;
+	return 1;
+}
+
+/* Page to evict is chosen using OPT over the lookahead window.
+ * Returns the page frame number (which is also the index in the coremap)
+ * for the page that is to be evicted.
+ */
+int wopt_evict() {
+	int result = heap[0];
+
+	assert(heap_size > 0);
+	heap_size--;
+	if (heap_size > 0) {
+		heap_swap(0, heap_size);
+		bubble_down(0);
+	}
+	heap_pos[result] = -1;
+	pagemap_remove(where, frame_page[result]);
+	return result;
+}
+
+/* This function is called on each access to a page to update any information
+ * needed by the wopt algorithm.
+ * Input: The page table entry for the page that is being accessed.
+ */
+void wopt_ref(pgtbl_entry_t *p) {
+	int frame = p->frame >> PAGE_SHIFT;
+	uint64_t slot = cursor % window;
+	unsigned long page;
+	long *last;
+
+	// Keep the window full: it covers references [cursor, cursor+window)
+	while (filled < cursor + window && window_extend()) {
+	}
+	assert(cursor < filled);
+	page = ring_page[slot];
+
+	// This occurrence is leaving the window
+	last = pagemap_lookup(tail, page);
+	if (last != NULL && (uint64_t)*last == cursor) {
+		pagemap_remove(tail, page);
+	}
+
+	if (heap_pos[frame] == -1) {
+		frame_page[frame] = page;
+		pagemap_insert(where, page, frame);
+		heap[heap_size] = frame;
+		heap_pos[frame] = heap_size++;
+	}
+	if (ring_next[slot] != NO_NEXT) {
+		set_key(frame, ring_next[slot]);
+	} else {
+		set_key(frame, UNKNOWN + (UNKNOWN - 1 - cursor));
+	}
+	cursor++;
+}
+
+/* Called for a page brought in without being referenced. If the page is
+ * in the window its next use is no later than its last occurrence there,
+ * which is used as its key; otherwise it is treated like any other page
+ * with no known next use.
+ */
+void wopt_fill(pgtbl_entry_t *p) {
+	int frame = p->frame >> PAGE_SHIFT;
+	unsigned long page = TRACE_PAGE(coremap[frame].pid,
+					coremap[frame].vaddr);
+	long *last = pagemap_lookup(tail, page);
+
+	assert(heap_pos[frame] == -1);
+	frame_page[frame] = page;
+	pagemap_insert(where, page, frame);
+	heap[heap_size] = frame;
+	heap_pos[frame] = heap_size++;
+	if (last != NULL) {
+		set_key(frame, *last);
+	} else {
+		set_key(frame, UNKNOWN + (UNKNOWN - 1 - cursor));
+	}
+}
+
+/* Initializes any data structures needed for this
+ * replacement algorithm.
+ */
+void wopt_init() {
+	int i;
+
+	window = opt_window;
+	if (tracefile == NULL && trace_buffer == NULL) {
+		fprintf(stderr, "Error: wopt needs the trace in a file (-f)\n");
+		exit(1);
+	}
+	ahead = sim_trace_open();
+	ring_page = malloc(window * sizeof(unsigned long));
+	ring_next = malloc(window * sizeof(uint64_t));
+	key = malloc(memsize * sizeof(uint64_t));
+	heap = malloc(memsize * sizeof(int));
+	heap_pos = malloc(memsize * sizeof(int));
+	frame_page = malloc(memsize * sizeof(unsigned long));
+	if (ring_page == NULL || ring_next == NULL || key == NULL ||
+	    heap == NULL || heap_pos == NULL || frame_page == NULL) {
+		perror("Failed to allocate wopt window");
+		exit(1);
+	}
+	tail = pagemap_create(0);
+	where = pagemap_create(memsize);
+	for (i = 0; i < memsize; i++) {
+		heap_pos[i] = -1;
+	}
+	heap_size = 0;
+	cursor = 0;
+	filled = 0;
+}
+
+/* Prints how the windowed result compares with exact OPT, if asked for
+ * with --compare-opt. This loads the whole trace, so only use it on traces
+ * that fit in memory.
+ */
+void wopt_report() {
+	uint64_t n, exact;
+	long diff;
+	trace_ref_t *refs = trace_buffer;
+
+	if (!opt_compare) {
+		return;
+	}
+	if (refs != NULL) {
+		n = trace_buffer_len;
+	} else {
+		refs = trace_load(tracefile, &n);
+	}
+	exact = opt_exact_misses(refs, n, memsize);
+	if (refs != trace_buffer) {
+		free(refs);
+	}
+	printf("Lookahead window: %lu references\n", window);
+	printf("Exact OPT misses: %lu\n", exact);
+	// Can be fewer, if pages were also brought in outside of faults
+	diff = (long)miss_count - (long)exact;
+	printf("Windowed OPT misses: %lu (%+ld, %.4f%% %s)\n", miss_count,
+	       diff, exact ? (double)labs(diff) / exact * 100 : 0.0,
+	       diff < 0 ? "fewer" : "more");
+}
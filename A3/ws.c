@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include "pagetable.h"
+#include "sim.h"
+
+/* Working set (Denning) and page-fault-frequency (Chu and Opderbeck)
+ * replacement. Unlike the other algorithms, these decide how many frames
+ * each process should have, and give frames back before memory is full.
+ *
+ * Time is virtual time: each process counts only its own references.
+ *   ws   A page stays resident while it has been referenced in the last
+ *        tau references of its process (--tau), and is released once it
+ *        has not.
+ *   pff  The resident set only grows while faults come more often than
+ *        every T references (--pff). On a fault that comes later than
+ *        that, every page not referenced since the previous fault is
+ *        released.
+ *
+ * Each process's frames are kept on its own list in order of last use, so
+ * the pages to release are always at the tail. -m is the physical memory
+ * that the resident sets must fit in. If it fills up anyway, the least
+ * recently used page of the faulting process is replaced (or of the
+ * largest process, if the faulting one has none), as with local LRU.
+ *
+ * The report gives the resident set size over the run, to show how much
+ * memory the trace needs at the fault rate it got.
+ */
+
+unsigned long ws_tau = 10000;
+unsigned long pff_threshold = 1000;
+
+#define NUM_PIDS     (TRACE_MAX_PID + 1)
+#define SENTINEL(pid) (memsize + (pid))
+#define BUCKET_REFS  1000   // References per resident set sample
+#define REPORT_ROWS  20     // Most lines in the report over time
+
+struct ws_proc {
+	uint64_t vtime;          // References by this process so far
+	uint64_t last_fault;     // vtime of its last fault (PFF)
+	int resident;            // Frames on its list
+	int peak;
+	uint64_t rss_sum;        // resident, summed over its references
+};
+
+struct bucket {
+	uint64_t rss_sum;        // Frames in use, summed over the references
+	int rss_peak;
+	unsigned long faults;
+};
+
+static int use_pff;
+static int *ws_next;         // Per-process lists of frames, most recently
+static int *ws_prev;         // used first, with sentinels after the frames
+static uint64_t *last_use;   // vtime of each frame's last reference
+static struct ws_proc procs[NUM_PIDS];
+static unsigned long released;
+
+static struct bucket *buckets;
+static int num_buckets, buckets_cap;
+static uint64_t total_refs;
+static uint64_t rss_sum;
+static int rss_peak;
+
+static void ws_unlink(int frame, int pid) {
+	ws_next[ws_prev[frame]] = ws_next[frame];
+	ws_prev[ws_next[frame]] = ws_prev[frame];
+	ws_next[frame] = -1;
+	procs[pid].resident--;
+}
+
+static void ws_push(int frame, int pid) {
+	int s = SENTINEL(pid);
+
+	ws_next[frame] = ws_next[s];
+	ws_prev[frame] = s;
+	ws_prev[ws_next[s]] = frame;
+	ws_next[s] = frame;
+	if (++procs[pid].resident > procs[pid].peak) {
+		procs[pid].peak = procs[pid].resident;
+	}
+}
+
+/* Releases the pages of process pid at the tail of its list whose last use
+ * was before time 'before'.
+ */
+static void release_before(int pid, uint64_t before) {
+	int frame;
+
+	while ((frame = ws_prev[SENTINEL(pid)]) != SENTINEL(pid) &&
+	       last_use[frame] < before) {
+		ws_unlink(frame, pid);
+		release_frame(frame);
+		released++;
+	}
+}
+
+/* Records the resident set size at this reference. */
+static void sample(int fault) {
+	int bucket = total_refs / BUCKET_REFS;
+	int rss = frames_in_use();
+
+	if (bucket == num_buckets) {
+		if (num_buckets == buckets_cap) {
+			buckets_cap = buckets_cap ? 2 * buckets_cap : 256;
+			buckets = realloc(buckets, buckets_cap * sizeof(struct bucket));
+			if (buckets == NULL) {
+				perror("Failed to allocate resident set samples");
+				exit(1);
+			}
+		}
+		buckets[num_buckets].rss_sum = 0;
+		buckets[num_buckets].rss_peak = 0;
+		buckets[num_buckets].faults = 0;
+		num_buckets++;
+	}
+	buckets[bucket].rss_sum += rss;
+	if (rss > buckets[bucket].rss_peak) {
+		buckets[bucket].rss_peak = rss;
+	}
+	buckets[bucket].faults += fault;
+	total_refs++;
+	rss_sum += rss;
+	if (rss > rss_peak) {
+		rss_peak = rss;
+	}
+}
+
+/* Page to evict when memory is full despite the resident sets shrinking.
+ * Returns the page frame number (which is also the index in the coremap)
+ * for the page that is to be evicted.
+ */
+int ws_evict_local(int pid) {
+	int frame = ws_prev[SENTINEL(pid)];
+
+	assert(frame != SENTINEL(pid));
+	ws_unlink(frame, pid);
+	return frame;
+}
+
+int ws_evict() {
+	int pid = curproc->pid;
+	int i;
+
+	if (procs[pid].resident == 0) {
+		for (i = 0; i < NUM_PIDS; i++) {
+			if (procs[i].resident > procs[pid].resident) {
+				pid = i;
+			}
+		}
+	}
+	return ws_evict_local(pid);
+}
+
+/* This function is called on each access to a page to update any information
+ * needed by the ws and pff algorithms, and releases the pages that have
+ * left the resident set.
+ * Input: The page table entry for the page that is being accessed.
+ */
+void ws_ref(pgtbl_entry_t *p) {
+	int frame = p->frame >> PAGE_SHIFT;
+	int pid = curproc->pid;
+	struct ws_proc *w = &procs[pid];
+	int fault = ws_next[frame] == -1;
+
+	w->vtime++;
+	if (!fault) {
+		ws_unlink(frame, pid);
+	} else if (use_pff) {
+		if (w->vtime - w->last_fault > pff_threshold) {
+			// Faults are rare enough: shrink to what has been used
+			release_before(pid, w->last_fault);
+		}
+		w->last_fault = w->vtime;
+	}
+	last_use[frame] = w->vtime;
+	ws_push(frame, pid);
+
+	if (!use_pff && w->vtime > ws_tau) {
+		release_before(pid, w->vtime - ws_tau + 1);
+	}
+	w->rss_sum += w->resident;
+	sample(fault);
+}
+
+/* Pages brought in without a reference join the resident set as if they
+ * had just been used, but do not advance the process's virtual time.
+ */
+void ws_fill(pgtbl_entry_t *p) {
+	int frame = p->frame >> PAGE_SHIFT;
+
+	assert(ws_next[frame] == -1);
+	last_use[frame] = procs[curproc->pid].vtime;
+	ws_push(frame, curproc->pid);
+}
+
+static void init_common() {
+	int i;
+
+	ws_next = malloc((memsize + NUM_PIDS) * sizeof(int));
+	ws_prev = malloc((memsize + NUM_PIDS) * sizeof(int));
+	last_use = malloc(memsize * sizeof(uint64_t));
+	if (ws_next == NULL || ws_prev == NULL || last_use == NULL) {
+		perror("Failed to allocate working set lists");
+		exit(1);
+	}
+	for (i = 0; i < memsize; i++) {
+		ws_next[i] = -1;
+	}
+	for (i = 0; i < NUM_PIDS; i++) {
+		ws_next[SENTINEL(i)] = ws_prev[SENTINEL(i)] = SENTINEL(i);
+		procs[i].vtime = procs[i].last_fault = 0;
+		procs[i].resident = procs[i].peak = 0;
+		procs[i].rss_sum = 0;
+	}
+	released = 0;
+	num_buckets = 0;
+	total_refs = rss_sum = 0;
+	rss_peak = 0;
+}
+
+/* Initialize any data structures needed for this
+ * replacement algorithm
+ */
+void ws_init() {
+	use_pff = 0;
+	init_common();
+}
+
+void pff_init() {
+	use_pff = 1;
+	init_common();
+}
+
+void ws_report() {
+	int per_row = (num_buckets + REPORT_ROWS - 1) / REPORT_ROWS;
+	int i, j, peak;
+	uint64_t sum, refs;
+	unsigned long faults;
+
+	if (use_pff) {
+		printf("PFF (T = %lu references): ", pff_threshold);
+	} else {
+		printf("Working set (tau = %lu references): ", ws_tau);
+	}
+	printf("resident set %.1f frames on average, peak %d of %u, "
+	       "%lu pages released\n",
+	       total_refs ? (double)rss_sum / total_refs : 0.0, rss_peak,
+	       memsize, released);
+
+	printf("Resident set over time:\n");
+	for (i = 0; i < num_buckets; i += per_row) {
+		sum = 0;
+		peak = 0;
+		faults = 0;
+		for (j = i; j < i + per_row && j < num_buckets; j++) {
+			sum += buckets[j].rss_sum;
+			faults += buckets[j].faults;
+			if (buckets[j].rss_peak > peak) {
+				peak = buckets[j].rss_peak;
+			}
+		}
+		refs = (j == num_buckets ? total_refs : (uint64_t)j * BUCKET_REFS) -
+			(uint64_t)i * BUCKET_REFS;
+		printf("  refs %lu-%lu: %.1f frames on average, peak %d, "
+		       "fault rate %.4f\n", (unsigned long)i * BUCKET_REFS,
+		       (unsigned long)(i * BUCKET_REFS + refs - 1),
+		       (double)sum / refs, peak, (double)faults / refs * 100);
+	}
+
+	if (num_processes > 1) {
+		for (i = 0; i < NUM_PIDS; i++) {
+			if (procs[i].vtime == 0) {
+				continue;
+			}
+			printf("Process %d resident set: %.1f frames on average, "
+			       "peak %d\n", i, (double)procs[i].rss_sum / procs[i].vtime,
+			       procs[i].peak);
+		}
+	}
+}